@@ -17,16 +17,16 @@ bool LustrieCore::init(tim::ivec2 resolution, bool fullscreen, HWND handle)
 
 	bool b = _graphics.init(resolution, fullscreen, handle);
 
-	eastl::string shaderSrc = eastl::string(dx12::g_headerShader) + eastl::string(dx12::g_planetShader);
+	eastl::string shaderSrc = eastl::string(dx12::g_quantizedHeaderShader) + eastl::string(dx12::g_planetShader);
 	_planet.planetMaterial = eastl::make_unique<Material>(_graphics.createTexturedForwardMaterial(shaderSrc.c_str(), 
-		eastl::make_shared<TexturePool>(Graphics::SIZE_TEXTURE_POOL), true, false));
+		eastl::make_shared<TexturePool>(Graphics::SIZE_TEXTURE_POOL), true, false, true));
 
-	auto grassMat = eastl::make_shared<Material>(_graphics.createPointToTriangleGSForwardMaterial(dx12::g_grassShader, _planet.planetMaterial->texturePool(), false, false));
+	auto grassMat = eastl::make_shared<Material>(_graphics.createPointToTriangleGSForwardMaterial(dx12::g_grassShader, _planet.planetMaterial->texturePool(), false, false, true));
 	_planet.grassMaterial.push_back(grassMat);
 
-	shaderSrc = eastl::string(dx12::g_headerShader) + eastl::string(dx12::g_defaultShader);
-	_planet.plantMaterial = eastl::make_unique<Material>(_graphics.createTexturedForwardMaterial(shaderSrc.c_str(), _planet.planetMaterial->texturePool(), true, false));
-	_planet.leafMaterial = eastl::make_unique<Material>(_graphics.createTexturedForwardMaterial(shaderSrc.c_str(), _planet.planetMaterial->texturePool(), false, false));
+	shaderSrc = eastl::string(dx12::g_quantizedHeaderShader) + eastl::string(dx12::g_defaultShader);
+	_planet.plantMaterial = eastl::make_unique<Material>(_graphics.createTexturedForwardMaterial(shaderSrc.c_str(), _planet.planetMaterial->texturePool(), true, false, true));
+	_planet.leafMaterial = eastl::make_unique<Material>(_graphics.createTexturedForwardMaterial(shaderSrc.c_str(), _planet.planetMaterial->texturePool(), false, false, true));
 	
 	auto sync = g_threadPool.push([&](int) {
 		auto gen = eastl::make_unique<tim::FractalNoise<tim::WorleyNoise<tim::vec3>>>(3, WorleyNoiseInstancer<WorleyNoise<vec3>>(50, 8, 1, rand()));
@@ -69,7 +69,7 @@ void LustrieCore::update()
 		planetParam.floorHeight = 0.7f;*/
 
 		_camera.position = vec3(0, 0, planetParam.sizePlanet.x()+planetParam.sizePlanet.y());
-		_planet.planet = eastl::unique_ptr<Planet>(new Planet(256, planetParam, rand()));
+		_planet.planet = eastl::unique_ptr<Planet>(new Planet(32, planetParam, rand()));
 
 #ifdef _DEBUG
 		for (int i = 0; i<1; ++i)
@@ -134,6 +134,11 @@ void LustrieCore::update()
 	if (numFrame % 500 == 0)
 	{
 		std::cout << (numFrame / frameTime) << " fps\n";
+
+		const auto& stats = _planet.planet->cullStats();
+		std::cout << "planet nodes: " << stats.visited << " visited, " << stats.frustumCulled << " outside the frustum, "
+				  << stats.horizonCulled << " behind the horizon, " << stats.backFacing << " back facing, " << stats.drawn << " drawn, " << stats.balanced << " coarsened for balance, "
+				  << stats.frustumSkipped << "/" << stats.horizonSkipped << " frustum/horizon tests skipped\n";
 		frameTime = 0;
 		numFrame = 0;
 	}
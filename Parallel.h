@@ -0,0 +1,76 @@
+#pragma once
+
+#include <core/type.h>
+#include <core/ctpl_stl.h>
+#include <EASTL/shared_ptr.h>
+#include <EASTL/algorithm.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+extern ctpl::thread_pool g_threadPool;
+
+namespace tim
+{
+	/* Run fun(i) for every i in [0, count) on g_threadPool.
+	   The calling thread works on the range too and only waits for the chunks already started by the pool,
+	   so it can safely be called from a task which is itself running on the pool. */
+	template<class F>
+	void parallelFor(uint count, const F& fun, uint grain = 1)
+	{
+		if (count == 0)
+			return;
+
+		grain = grain == 0 ? 1 : grain;
+		uint nbChunks = (count + grain - 1) / grain;
+
+		if (nbChunks == 1)
+		{
+			for (uint i = 0; i < count; ++i)
+				fun(i);
+			return;
+		}
+
+		struct State
+		{
+			std::atomic<uint> next = { 0 };
+			std::atomic<uint> done = { 0 };
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+
+		auto state = eastl::make_shared<State>();
+		const F* funPtr = &fun;
+
+		// the state is kept alive by the tasks, fun is only touched while chunks remain
+		auto work = [state, funPtr, count, grain]()
+		{
+			while (true)
+			{
+				uint begin = state->next.fetch_add(grain);
+				if (begin >= count)
+					return;
+
+				uint end = begin + grain < count ? begin + grain : count;
+				for (uint i = begin; i < end; ++i)
+					(*funPtr)(i);
+
+				if (state->done.fetch_add(end - begin) + (end - begin) == count)
+				{
+					std::lock_guard<std::mutex> _(state->mutex);
+					state->finished.notify_all();
+				}
+			}
+		};
+
+		uint nbTasks = eastl::min(uint(g_threadPool.size()), nbChunks - 1);
+		for (uint i = 0; i < nbTasks; ++i)
+			g_threadPool.push([work](int) { work(); });
+
+		work();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&]() { return state->done.load() == count; });
+	}
+}
@@ -2,6 +2,9 @@
 
 #include <EASTL/vector.h>
 #include "geometry/Mesh.h"
+#include "PlanetQuadtree.h"
+#include "PlanetHeightmap.h"
+#include "TaskGraph.h"
 #include "math/Sphere.h"
 #include "math/Camera.h"
 #include "graphics\Graphics.h"
@@ -18,8 +21,6 @@ extern eastl::unique_ptr<tim::FractalNoise<tim::WorleyNoise<tim::vec3>>> g_fract
 class Planet : NonCopyable
 {
 public:
-	static constexpr uint NB_SPLIT = 8;
-
 	struct Parameter
 	{
 		vec2 sizePlanet = { 100, 25 };
@@ -39,23 +40,40 @@ public:
 
 		float floorHeight = 0.3f;
 
+		tim::uint heightmapResolution = 512; // cells on a side of a face, the finest detail of the meshes
+		CubeSphere::Warp warp = CubeSphere::TANGENT; // of the faces on the sphere, for the meshes, the heightmap and the grass
+
 		static Parameter generate(int seed);
 	};
 
+	/* The resolution of the quadtree nodes, in quads on a side. The heightmap is baked then the roots are built
+	   on the thread pool, the destruction cancels them */
 	Planet(tim::uint, const Parameter& param = Parameter(), int seed = 7);
 
-    template<class Noise> void applyNoise(const Noise&, float factor, int side = Planet::NB_SIDE);
-
-    tim::UVMesh generateMesh(tim::vec3) const;
-
 	void cull(const tim::Camera&, eastl::vector<ObjectInstance>&);
+	const PlanetQuadtree::CullStats& cullStats() const; // of the last cull
 
 	tim::vec3 computeUp(tim::vec3 pos);
 
+	/* Set once the heightmap is baked, or its bake cancelled */
+	std::shared_future<void> surfaceBaked() const;
+
+	/* Sampled from the heightmap, once it is baked */
 	vec3 evalNoise(vec3) const;
-	vec3 evalNormal(vec3, float delta = 0.05f) const;
+	vec3 evalNormal(vec3) const;
 	float isFloor(vec3) const;
 
+	struct SurfaceSample
+	{
+		vec3 position; // as evalNoise
+		vec3 normal; // pointing inward, as evalNormal
+		float heightAboveFloor; // in the units of the radius, 0 on the floor, as isFloor
+		float slope; // angle in radians between the normal and the vertical
+	};
+
+	/* evalNoise, evalNormal and isFloor of count directions at once, split on the thread pool */
+	void querySurface(const vec3* dirs, SurfaceSample* out, tim::uint count) const;
+
 	const Parameter& parameter() const;
 	vec3 position() const;
 
@@ -63,35 +81,8 @@ private:
 	vec3 _position;
 	Parameter _parameter;
 
-    using BatchInstance = eastl::vector<tim::BaseMesh::Face>;
-	static const int NB_LODS = 4;
-
-    enum { LOW_RES_PLANET = -1, SIDE_X=0, SIDE_NX, SIDE_Y, SIDE_NY, SIDE_Z, SIDE_NZ, NB_SIDE=6 };
-    eastl::array<tim::BaseMesh, NB_SIDE> _planetSide;
-	eastl::array<tim::BaseMesh, NB_SIDE> _planetSideLowRes;
-
-    tim::uint _gridResolution;
-    eastl::vector<tim::uint> _gridIndex;
-
-	template <class T> using GridType = eastl::array<eastl::array<T, NB_SPLIT>, NB_SPLIT>;
-	GridType< eastl::array<BatchInstance, NB_LODS> > _grid;
-
-	bool _isLowResReady = false;
-	bool _isSideReady[NB_SIDE] = { false };
-
-	eastl::array<MeshBuffers, NB_SIDE> _lowResMesh;
-	eastl::array< GridType<eastl::array<MeshBuffers, NB_LODS>>, NB_SIDE > _planetMesh;
-
-private:
-    tim::uint indexGrid(tim::uint,tim::uint) const;
-    tim::uint& indexGrid(tim::uint,tim::uint);
-
-    void generateGrid(tim::uint);
-    void generateBatchIndex(tim::uint, bool);
-	void generateLowResGrid(tim::uint);
-	void generateSideMeshBuffers(int side);
-
-	int distanceToLod(float) const;
+	/* From the noise, for the heightmap and the quadtree nodes finer than it */
+	float evalRadius(vec3 dir) const;
 
 private:
 
@@ -158,41 +149,16 @@ private:
 
 	};
 	NoiseClosure _noise;
+
+	PlanetHeightmap _heightmap;
+	PlanetQuadtree _quadtree;
+
+	/* Destroyed first, so its stages are done before the rest */
+	TaskGraph _generation;
+	TaskGraph::Stage _bakeStage;
 };
 
 inline const Planet::Parameter& Planet::parameter() const { return _parameter; }
 inline vec3 Planet::position() const { return _position; }
-
-inline tim::uint Planet::indexGrid(tim::uint i,tim::uint j) const
-{ return _gridIndex[j +  i*_gridResolution]; }
-
-inline tim::uint& Planet::indexGrid(tim::uint i,tim::uint j)
-{ return _gridIndex[j +  i*_gridResolution]; }
-
-template<class Noise> void Planet::applyNoise(const Noise& noise, float factor, int side)
-{
-	if (side == Planet::NB_SIDE || side == Planet::LOW_RES_PLANET)
-	{
-		for (auto& side : _planetSideLowRes)
-		{
-			side.mapVertices([&](tim::vec3 v) {
-				v.normalize();
-				v *= (1 + noise(v*0.5f + 0.5f)*factor);
-				return v;
-			});
-		}
-	}
-
-	for (size_t i=0  ; i<_planetSide.size() ; ++i)
-	{
-		if (side != i && side != Planet::NB_SIDE)
-			continue;
-
-		auto& side = _planetSide[i];
-		side.mapVertices([&](tim::vec3 v) {
-			v.normalize();
-			v *= (1 + noise(v*0.5f + 0.5f)*factor);
-			return v;
-		});
-	}
-}
+inline const PlanetQuadtree::CullStats& Planet::cullStats() const { return _quadtree.cullStats(); }
+inline std::shared_future<void> Planet::surfaceBaked() const { return _generation.future(_bakeStage); }
@@ -1,14 +1,18 @@
 #include "PlanetGrass.h"
 #include <core/Logger.h>
 #include "math/Frustum.h"
+#include "geometry/MeshEncoder.h"
+#include "math/BoundingVolume.h"
 
 PlanetGrass::PlanetGrass(Planet& planet, int seed) : _seed(seed), _planet(planet)
 {
-	g_threadPool.push([=, &planet](int) {
-		prepare();
-		generateMeshData(planet);
-		createMeshBuffers();
-	});
+	const auto prepared = _generation.add([this](const CancelToken&) { prepare(); });
+	const auto generated = _generation.add([this, &planet](const CancelToken& token)
+	{
+		if (token.wait(planet.surfaceBaked()))
+			generateMeshData(planet, token);
+	}, { prepared });
+	_generation.add([this](const CancelToken& token) { createMeshBuffers(token); }, { generated });
 }
 
 void PlanetGrass::cull(const tim::Camera& camera, eastl::vector<ObjectInstance>& meshs)
@@ -26,7 +30,8 @@ void PlanetGrass::cull(const tim::Camera& camera, eastl::vector<ObjectInstance>&
 
 		for (Batch& batch : _batchSide[i])
 		{
-			if(frust.collide(batch.sphere) && (batch.sphere.center() - cam.pos).length2() < 50*50 && batch.mesh.numIndices() > 0)
+			Sphere sphere(batch.sphere.center() + _planet.position(), batch.sphere.radius());
+			if(frust.collide(sphere) && (sphere.center() - cam.pos).length2() < 50*50 && batch.mesh.numIndices() > 0)
 				meshs.push_back({ &(batch.mesh), transform, MaterialParameter() });
 		}	
 	}
@@ -34,59 +39,56 @@ void PlanetGrass::cull(const tim::Camera& camera, eastl::vector<ObjectInstance>&
 
 void PlanetGrass::prepare()
 {
+	// the squares of the faces, placed on the sphere with the warp of the planet as its meshes
+	const float step = 1.f / NB_SPLIT;
 	for (int side = 0; side < NB_SIDE; ++side)
 	{
-		vec3 start, dir1, dir2;
-		switch (side)
-		{
-		case SIDE_X:
-			start = vec3(1, -1, 1), dir1 = vec3(0, 1, 0); dir2 = vec3(0, 0, -1); break;
-		case SIDE_NX:
-			start = vec3(-1, 1, 1), dir1 = vec3(0, -1, 0); dir2 = vec3(0, 0, -1); break;
-		case SIDE_Y:
-			start = vec3(1, 1, 1), dir1 = vec3(-1, 0, 0); dir2 = vec3(0, 0, -1); break;
-		case SIDE_NY:
-			start = vec3(-1, -1, 1), dir1 = vec3(1, 0, 0); dir2 = vec3(0, 0, -1); break;
-		case SIDE_Z:
-			start = vec3(-1, 1, 1), dir1 = vec3(1, 0, 0); dir2 = vec3(0, -1, 0); break;
-		case SIDE_NZ:
-			start = vec3(-1, -1, -1), dir1 = vec3(1, 0, 0); dir2 = vec3(0, 1, 0); break;
-		}
-
-		vec3 step1 = (dir1*2) / float(NB_SPLIT), step2 = (dir2*2) / float(NB_SPLIT);
-
 		for (uint i = 0; i < NB_SPLIT; ++i)
 		{
 			for (uint j = 0; j < NB_SPLIT; ++j)
-			{
-				_batchSide[side][i*NB_SPLIT + j].base1 = step1;
-				_batchSide[side][i*NB_SPLIT + j].base2 = step2;
-				_batchSide[side][i*NB_SPLIT + j].start = start + (step1 * float(i)) + (step2 * float(j));
-			}
+				_batchSide[side][i*NB_SPLIT + j].origin = vec2(step * i, step * j);
 		}
 	}
 }
 
-void PlanetGrass::generateMeshData(Planet& planet)
+void PlanetGrass::generateMeshData(Planet& planet, const CancelToken& token)
 {
 	std::mt19937 randEngine(_seed);
 	std::uniform_real_distribution<float> random;
 
-	for (auto& side : _batchSide)
+	const CubeSphere::Warp warp = planet.parameter().warp;
+	const float step = 1.f / NB_SPLIT;
+
+	for (uint face = 0; face < NB_SIDE; ++face)
 	{
-		for (Batch& batch : side)
-		{
-			vec3 minB = { 9999,9999,9999 }, maxB = -minB;
+		if (token.isCancelled())
+			return;
 
-			vec3 precomputedNormal[2][2];
-			precomputedNormal[0][0] = planet.evalNormal(batch.start);
-			precomputedNormal[1][0] = planet.evalNormal(batch.start + batch.base1);
-			precomputedNormal[0][1] = planet.evalNormal(batch.start + batch.base2);
-			precomputedNormal[1][1] = planet.evalNormal(batch.start + batch.base1 + batch.base2);
+		auto& side = _batchSide[face];
+		auto direction = [&](const Batch& batch, float x, float y) { return CubeSphere::direction(face, batch.origin + vec2(x, y) * step, warp); };
 
-			vec3 v1 = batch.start.resized(planet.parameter().sizePlanet.x());
-			vec3 v2 = (batch.start + batch.base1).resized(planet.parameter().sizePlanet.x());
-			vec3 v3 = (batch.start + batch.base2).resized(planet.parameter().sizePlanet.x());
+		// the 4 corners then the candidate blades of each batch, queried at once for the whole side
+		struct Candidate
+		{
+			vec2 coord;
+			float keep;
+		};
+		eastl::vector<Candidate> candidates;
+		eastl::vector<vec3> dirs;
+		eastl::array<uint, NB_SPLIT*NB_SPLIT> firstDir;
+
+		for (size_t b = 0; b < side.size(); ++b)
+		{
+			const Batch& batch = side[b];
+			firstDir[b] = uint(dirs.size());
+			dirs.push_back(direction(batch, 0, 0));
+			dirs.push_back(direction(batch, 1, 0));
+			dirs.push_back(direction(batch, 0, 1));
+			dirs.push_back(direction(batch, 1, 1));
+
+			vec3 v1 = dirs[firstDir[b]] * planet.parameter().sizePlanet.x();
+			vec3 v2 = dirs[firstDir[b] + 1] * planet.parameter().sizePlanet.x();
+			vec3 v3 = dirs[firstDir[b] + 2] * planet.parameter().sizePlanet.x();
  
 			float surface = (v1-v2).length() * (v1 - v3).length();
 #ifdef _DEBUG
@@ -98,31 +100,68 @@ void PlanetGrass::generateMeshData(Planet& planet)
 			for (int i = 0; i < nbGrass; ++i)
 			{
 				vec2 r_vec(random(randEngine), random(randEngine));
-				vec3 v = batch.start + batch.base1*r_vec.x() + batch.base2*r_vec.y();
-				vec3 v_n = -v.normalized();
+				candidates.push_back({ r_vec, random(randEngine) });
+				dirs.push_back(direction(batch, r_vec.x(), r_vec.y()));
+			}
+		}
 
-				float floorH = planet.isFloor(v);
-				if (random(randEngine) < floorH)
-					continue;
+		eastl::vector<Planet::SurfaceSample> samples(dirs.size());
+		planet.querySurface(dirs.data(), samples.data(), uint(dirs.size()));
 
-				v = planet.evalNoise(v);
-				batch.vertex_normal.push_back(eastl::make_pair(v, 
-					interpolateCos2(precomputedNormal[0][0], precomputedNormal[1][0], precomputedNormal[0][1], precomputedNormal[1][1], r_vec.x(), r_vec.y())));
+		size_t candidate = 0;
+		for (size_t b = 0; b < side.size(); ++b)
+		{
+			Batch& batch = side[b];
+			const Planet::SurfaceSample* sample = samples.data() + firstDir[b];
+			const uint nbGrass = (b + 1 < side.size() ? firstDir[b + 1] : uint(dirs.size())) - firstDir[b] - 4;
 
-				for (int a = 0; a < 3; ++a) minB[a] = min(minB[a], v[a]);
-				for (int a = 0; a < 3; ++a) maxB[a] = max(maxB[a], v[a]);
+			for (uint i = 0; i < nbGrass; ++i, ++candidate)
+			{
+				const Candidate& c = candidates[candidate];
+				const Planet::SurfaceSample& s = sample[4 + i];
+				if (c.keep < s.heightAboveFloor)
+					continue;
+
+				batch.vertex_normal.push_back(eastl::make_pair(s.position,
+					interpolateCos2(sample[0].normal, sample[1].normal, sample[2].normal, sample[3].normal, c.coord.x(), c.coord.y())));
 			}
 
-			batch.sphere = Sphere((minB + maxB)*0.5f, (minB - maxB).length());
+			// the blades are built on the gpu above the points
+			static_assert(sizeof(batch.vertex_normal[0]) == sizeof(float) * 6, "The points are read with a stride of 6 floats");
+			Sphere sphere = BoundingVolume::minimalSphere(reinterpret_cast<const float*>(batch.vertex_normal.data()), batch.vertex_normal.size(), 6);
+			batch.sphere = Sphere(sphere.center(), sphere.radius() + BLADE_MARGIN);
 		}
 	}
 }
 
-void PlanetGrass::createMeshBuffers()
+void PlanetGrass::createMeshBuffers(const CancelToken& token)
 {
+	// one lattice for all the sides, the blades along the edge of a side are quantized as the ones of its neighbour
+	float maxExtent = 0;
+	for (auto& side : _batchSide)
+	{
+		vec3 minB, maxB;
+		bool empty = true;
+		for (auto& batch : side)
+		{
+			for (auto v_n : batch.vertex_normal)
+			{
+				for (int a = 0; a < 3; ++a) minB[a] = empty ? v_n.first[a] : eastl::min(minB[a], v_n.first[a]);
+				for (int a = 0; a < 3; ++a) maxB[a] = empty ? v_n.first[a] : eastl::max(maxB[a], v_n.first[a]);
+				empty = false;
+			}
+		}
+		for (int a = 0; a < 3; ++a)
+			maxExtent = eastl::max(maxExtent, maxB[a] - minB[a]);
+	}
+	const float step = MeshEncoder::latticeStep(maxExtent);
+
 	int sideIndex = 0;
 	for (auto& side : _batchSide)
 	{
+		if (token.isCancelled())
+			return;
+
 		eastl::array<uint, NB_SPLIT*NB_SPLIT> startIndexOffset;
 		eastl::array<uint, NB_SPLIT*NB_SPLIT> nbIndex;
 		Mesh sideMesh;
@@ -145,8 +184,18 @@ void PlanetGrass::createMeshBuffers()
 			batch.vertex_normal.clear();
 		}
 
+		// 8 bytes per blade: quantized position with the octahedral normal in w
+		MeshEncoder::Parameter encoding;
+		encoding.normals = MeshEncoder::OCT_SNORM8;
+		encoding.withUV = false;
+		MeshEncoder::EncodedMesh encoded;
+		MeshEncoder::encodeOnLattice(sideMesh, encoding, step, encoded); // the step covers every side
+
 		LOG("Planet side, # of grass:", sideMesh.nbVertices());
-		_grassMesh[sideIndex] = MeshBuffers::createFromMesh(sideMesh, nullptr, 1, true, false);
+#ifdef _DEBUG
+		LOG("Planet side, max grass position error ", MeshEncoder::computeError(sideMesh, encoded).maxPositionError);
+#endif
+		_grassMesh[sideIndex] = MeshBuffers::createFromEncodedMesh(encoded, sideMesh, nullptr, 1);
 		_grassMesh[sideIndex].setTopology(MeshBuffers::Points);
 
 		indexBatch = 0;
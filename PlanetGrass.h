@@ -2,10 +2,12 @@
 
 #include "math/Vector.h"
 #include "Planet.h"
+#include "TaskGraph.h"
 
 class PlanetGrass
 {
 public:
+	/* The blades are generated on the thread pool once the surface of the planet is baked, the destruction cancels them */
 	PlanetGrass(Planet&, int seed = 42);
 	
 	void cull(const tim::Camera&, eastl::vector<ObjectInstance>&);
@@ -14,23 +16,26 @@ private:
 	int _seed;
 	Planet& _planet;
 
-	enum { SIDE_X = 0, SIDE_NX, SIDE_Y, SIDE_NY, SIDE_Z, SIDE_NZ, NB_SIDE = 6 };
+	static constexpr int NB_SIDE = CubeSphere::NB_FACES; // a side per face of the cube sphere of the planet
 	bool _isSideReady[NB_SIDE] = { false };
 
 	struct Batch
 	{
-		vec3 start, base1, base2;
+		vec2 origin; // in the coordinates of the face, the batches are 1/NB_SPLIT wide
 		eastl::vector<eastl::pair<vec3, vec3>> vertex_normal;
 		MeshBuffers mesh;
-		Sphere sphere;
+		Sphere sphere; // in the space of the planet, set once the points are generated
 	};
 
 	MeshBuffers _grassMesh[NB_SIDE];
 	static constexpr int NB_SPLIT = 16;
+	static constexpr float BLADE_MARGIN = 0.5f;
 	eastl::array<Batch, NB_SPLIT*NB_SPLIT> _batchSide[NB_SIDE];
 
+	TaskGraph _generation; // destroyed first
+
 private:
 	void prepare();
-	void generateMeshData(Planet&);
-	void createMeshBuffers();
+	void generateMeshData(Planet&, const CancelToken&);
+	void createMeshBuffers(const CancelToken&);
 };
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "PlanetHeightmap.h"
+#include "Parallel.h"
+
+using namespace tim;
+
+namespace
+{
+	const uint ROWS_PER_TASK = 16;
+}
+
+PlanetHeightmap::PlanetHeightmap(uint resolution, CubeSphere::Warp warp) : _resolution(2), _warp(warp)
+{
+	while (_resolution < resolution)
+		_resolution *= 2;
+}
+
+void PlanetHeightmap::bake(const SurfaceFun& radiusFun, const SurfaceFun& floorFun, const CancelToken* token)
+{
+	auto cancelled = [token]() { return token && token->isCancelled(); };
+	const uint n = _resolution + 1;
+	const uint ringSize = _resolution + 3;
+	const float step = texelSize();
+
+	for (Face& face : _faces)
+	{
+		face.radius.resize(ringSize * ringSize);
+		face.floor.resize(n * n);
+		face.normal.resize(n * n);
+	}
+
+	// the radius with the ring and the floor, then the normals which need the neighbours
+	eastl::vector<vec3> points[CubeSphere::NB_FACES];
+	for (auto& p : points)
+		p.resize(ringSize * ringSize);
+
+	const uint nbRingBands = (ringSize + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	parallelFor(CubeSphere::NB_FACES * nbRingBands, [&](uint task)
+	{
+		if (cancelled())
+			return;
+
+		const uint f = task / nbRingBands;
+		Face& face = _faces[f];
+		const int first = int((task % nbRingBands) * ROWS_PER_TASK) - 1;
+		const int last = eastl::min(first + int(ROWS_PER_TASK), int(_resolution) + 2);
+
+		for (int i = first; i < last; ++i)
+		{
+			for (int j = -1; j <= int(_resolution) + 1; ++j)
+			{
+				const vec3 dir = CubeSphere::direction(f, vec2(step * i, step * j), _warp);
+				const float radius = radiusFun(dir);
+				face.radius[ringIndex(i, j)] = radius;
+				points[f][ringIndex(i, j)] = dir * radius;
+
+				if (i >= 0 && j >= 0 && i <= int(_resolution) && j <= int(_resolution))
+					face.floor[texelIndex(i, j)] = floorFun(dir);
+			}
+		}
+	}, 1);
+
+	if (cancelled())
+		return;
+
+	const uint nbBands = (n + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	parallelFor(CubeSphere::NB_FACES * nbBands, [&](uint task)
+	{
+		const uint f = task / nbBands;
+		Face& face = _faces[f];
+		auto point = [&](int i, int j) { return points[f][ringIndex(i, j)]; };
+
+		const int first = int((task % nbBands) * ROWS_PER_TASK);
+		const int last = eastl::min(first + int(ROWS_PER_TASK), int(n));
+
+		for (int i = first; i < last; ++i)
+		{
+			for (int j = 0; j < int(n); ++j)
+			{
+				vec3 normal = (point(i + 1, j) - point(i - 1, j)).cross(point(i, j + 1) - point(i, j - 1)).normalized();
+				if (normal.dot(point(i, j)) > 0)
+					normal *= -1;
+				face.normal[texelIndex(i, j)] = normal;
+			}
+		}
+	}, 1);
+
+	if (cancelled())
+		return;
+
+	parallelFor(CubeSphere::NB_FACES, [&](uint f) { buildPyramid(_faces[f]); }, 1);
+}
+
+void PlanetHeightmap::buildPyramid(Face& face)
+{
+	face.minMax.clear();
+
+	for (uint cells = _resolution; cells > 0; cells /= 2)
+	{
+		eastl::vector<vec2> level(cells * cells);
+
+		for (uint i = 0; i < cells; ++i)
+		{
+			for (uint j = 0; j < cells; ++j)
+			{
+				// the 4 corner texels on the first level, the 4 cells below on the next ones
+				vec2 children[4];
+				if (face.minMax.empty())
+				{
+					for (uint k = 0; k < 4; ++k)
+						children[k] = vec2::construct(face.radius[ringIndex(int(i + k / 2), int(j + k % 2))]);
+				}
+				else
+				{
+					const auto& below = face.minMax.back();
+					for (uint k = 0; k < 4; ++k)
+						children[k] = below[(i * 2 + k / 2) * cells * 2 + j * 2 + k % 2];
+				}
+
+				vec2 range = children[0];
+				for (uint k = 1; k < 4; ++k)
+					range = vec2(eastl::min(range.x(), children[k].x()), eastl::max(range.y(), children[k].y()));
+				level[i * cells + j] = range;
+			}
+		}
+
+		face.minMax.push_back(eastl::move(level));
+	}
+}
+
+PlanetHeightmap::Sample PlanetHeightmap::locate(vec3 dir) const
+{
+	vec2 coord;
+	Sample s;
+	s.face = CubeSphere::locate(dir, coord, _warp);
+
+	const float x = coord.x() * _resolution, y = coord.y() * _resolution;
+	s.i = eastl::min(uint(x), _resolution - 1);
+	s.j = eastl::min(uint(y), _resolution - 1);
+	s.x = x - s.i;
+	s.y = y - s.j;
+	return s;
+}
+
+template<class T, class Index>
+T PlanetHeightmap::bilinear(const Sample& s, const eastl::vector<T>& data, const Index& index) const
+{
+	T a = data[index(s.i, s.j)] * (1 - s.y) + data[index(s.i, s.j + 1)] * s.y;
+	T b = data[index(s.i + 1, s.j)] * (1 - s.y) + data[index(s.i + 1, s.j + 1)] * s.y;
+	return a * (1 - s.x) + b * s.x;
+}
+
+float PlanetHeightmap::radius(vec3 dir) const
+{
+	Sample s = locate(dir);
+	return bilinear(s, _faces[s.face].radius, [this](uint i, uint j) { return ringIndex(int(i), int(j)); });
+}
+
+vec3 PlanetHeightmap::position(vec3 dir) const
+{
+	return dir.normalized() * radius(dir);
+}
+
+vec3 PlanetHeightmap::normal(vec3 dir) const
+{
+	Sample s = locate(dir);
+	return bilinear(s, _faces[s.face].normal, [this](uint i, uint j) { return texelIndex(i, j); }).normalized();
+}
+
+float PlanetHeightmap::floor(vec3 dir) const
+{
+	Sample s = locate(dir);
+	return bilinear(s, _faces[s.face].floor, [this](uint i, uint j) { return texelIndex(i, j); });
+}
+
+void PlanetHeightmap::sample(vec3 dir, float& radius, vec3& normal, float& floor) const
+{
+	Sample s = locate(dir);
+	const Face& face = _faces[s.face];
+	radius = bilinear(s, face.radius, [this](uint i, uint j) { return ringIndex(int(i), int(j)); });
+	normal = bilinear(s, face.normal, [this](uint i, uint j) { return texelIndex(i, j); }).normalized();
+	floor = bilinear(s, face.floor, [this](uint i, uint j) { return texelIndex(i, j); });
+}
+
+vec2 PlanetHeightmap::radiusRange(uint face, vec2 origin, float size) const
+{
+	const auto& pyramid = _faces[face].minMax;
+
+	uint level = 0;
+	while (level + 1 < pyramid.size() && float(1u << level) < size * _resolution)
+		++level;
+
+	const uint cells = _resolution >> level;
+	auto cell = [&](float c) { return eastl::min(cells - 1, uint(eastl::max(0.f, c) * cells)); };
+
+	const uint i0 = cell(origin.x()), i1 = cell(origin.x() + size);
+	const uint j0 = cell(origin.y()), j1 = cell(origin.y() + size);
+
+	vec2 range = pyramid[level][i0 * cells + j0];
+	for (uint i = i0; i <= i1; ++i)
+	{
+		for (uint j = j0; j <= j1; ++j)
+		{
+			const vec2 r = pyramid[level][i * cells + j];
+			range = vec2(eastl::min(range.x(), r.x()), eastl::max(range.y(), r.y()));
+		}
+	}
+	return range;
+}
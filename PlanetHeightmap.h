@@ -0,0 +1,77 @@
+#pragma once
+
+#include <EASTL/vector.h>
+#include "geometry/CubeSphere.h"
+#include "TaskGraph.h"
+
+/* Cache of the surface of a planet on the faces of the cube sphere, the source of the surface data once baked.
+   A face has (resolution+1)² texels at the corners of resolution² cells, on the directions of CubeSphere, so two faces
+   have the same texels on their common edge, with the warp of the sphere it caches. A texel stores the radius of the surface, its height above the floor and the normal,
+   pointing inward as the normals of the planet meshes. The normals are the central differences of the neighbouring texels,
+   a ring of radius texels being baked around each face for its borders.
+   The queries sample the 4 texels around a direction bilinearly, so the cost of the noise is the number of texels.
+   The faces are baked in parallel by bands of rows. A pyramid per face keeps the min and max radius of its cells,
+   the resolution halving from a level to the next, for the bounds of a region without reading its texels. */
+class PlanetHeightmap
+{
+public:
+	using SurfaceFun = eastl::function<float(tim::vec3)>; // of a unit direction
+
+	/* The number of cells on a side, rounded up to a power of 2 */
+	PlanetHeightmap(tim::uint resolution, tim::CubeSphere::Warp);
+
+	/* Left incomplete if the token is cancelled */
+	void bake(const SurfaceFun& radius, const SurfaceFun& floor, const tim::CancelToken* = nullptr);
+
+	tim::uint resolution() const;
+	tim::CubeSphere::Warp warp() const;
+	float texelSize() const; // in face coordinates
+
+	/* The direction does not need to be normalized */
+	float radius(tim::vec3) const;
+	tim::vec3 position(tim::vec3) const;
+	tim::vec3 normal(tim::vec3) const;
+	float floor(tim::vec3) const;
+
+	/* The three at once, locating the direction once */
+	void sample(tim::vec3, float& radius, tim::vec3& normal, float& floor) const;
+
+	/* x=min, y=max radius over a square of a face, from the first level of the pyramid where it covers 2x2 cells at most */
+	tim::vec2 radiusRange(tim::uint face, tim::vec2 origin, float size) const;
+
+private:
+	struct Face
+	{
+		eastl::vector<float> radius; // (resolution+3)², the ring included
+		eastl::vector<float> floor;
+		eastl::vector<tim::vec3> normal;
+		eastl::vector<eastl::vector<tim::vec2>> minMax; // the level l has (resolution >> l)² cells
+	};
+
+	/* The cell of a direction, the texels (i,j) to (i+1,j+1), and the position inside */
+	struct Sample
+	{
+		tim::uint face;
+		tim::uint i, j;
+		float x, y;
+	};
+
+	tim::uint _resolution;
+	const tim::CubeSphere::Warp _warp;
+	Face _faces[tim::CubeSphere::NB_FACES];
+
+private:
+	tim::uint texelIndex(tim::uint i, tim::uint j) const;
+	tim::uint ringIndex(int i, int j) const;
+
+	Sample locate(tim::vec3) const;
+	template<class T, class Index> T bilinear(const Sample&, const eastl::vector<T>&, const Index&) const;
+	void buildPyramid(Face&);
+};
+
+inline tim::uint PlanetHeightmap::resolution() const { return _resolution; }
+inline tim::CubeSphere::Warp PlanetHeightmap::warp() const { return _warp; }
+inline float PlanetHeightmap::texelSize() const { return 1.f / _resolution; }
+
+inline tim::uint PlanetHeightmap::texelIndex(tim::uint i, tim::uint j) const { return i * (_resolution + 1) + j; }
+inline tim::uint PlanetHeightmap::ringIndex(int i, int j) const { return tim::uint((i + 1) * int(_resolution + 3) + j + 1); }
@@ -1,24 +1,93 @@
 #include "PlanetPlants.h"
 #include "geometry\LTree.h"
 #include "geometry\LeafGenerator.h"
+#include "geometry/MeshSimplifier.h"
+#include "geometry/MeshOptimizer.h"
+#include "geometry/MeshFile.h"
+#include "geometry/TubeMesher.h"
 #include "PlanetSystem.h"
+#include "Parallel.h"
+#include <core/Logger.h>
+#include <core/Chrono.h>
+#include <cstdio>
 
 PlanetPlants::PlanetPlants(int seed) : _seed(seed)
 {
 	
 }
 
-void PlanetPlants::cull(const tim::Camera&, eastl::vector<ObjectInstance>& trunkPart, eastl::vector<ObjectInstance>& leafPart)
+void PlanetPlants::cull(const tim::Camera& camera, eastl::vector<ObjectInstance>& trunkPart, eastl::vector<ObjectInstance>& leafPart)
 {
+	if (!_generation.isDone())
+		return;
+
+	_clusterDraws.clear();
+
+	MeshletBuilder::CullParameter cullParam;
+	tim::Camera cam = camera;
+	cullParam.frustum.buildCameraFrustum(cam, Frustum::NEAR_PLAN);
+	cullParam.cameraPos = camera.pos;
+
 	for (auto& inst : _instances)
 	{
-		trunkPart.push_back({ _plants[inst.indexPlant].lods[0].meshs[0].get(), inst.transform, inst.material[0] });
-		leafPart.push_back({ _plants[inst.indexPlant].lods[0].meshs[1].get(), inst.transform, inst.material[1] });
+		const Plant& plant = _plants[inst.indexPlant];
+		const auto& lods = plant.lods;
+		float distance = (inst.position - camera.pos).length();
+
+		size_t lod = 0;
+		while (lod + 1 < lods.size() && lods[lod + 1].distance <= distance)
+			++lod;
+
+		if (lod == 0 && plant.clusters[0].mesh && plant.clusters[1].mesh)
+		{
+			// the leaves are drawn on both sides
+			cullParam.transform = inst.transform.transposed();
+			cullParam.backface = true;
+			cullClusters(plant.clusters[0], cullParam, { lods[0].meshs[0].get(), inst.transform, inst.material[0] }, trunkPart);
+			cullParam.backface = false;
+			cullClusters(plant.clusters[1], cullParam, { lods[0].meshs[1].get(), inst.transform, inst.material[1] }, leafPart);
+			continue;
+		}
+
+		trunkPart.push_back({ lods[lod].meshs[0].get(), inst.transform, inst.material[0] });
+		leafPart.push_back({ lods[lod].meshs[1].get(), inst.transform, inst.material[1] });
+	}
+}
+
+void PlanetPlants::cullClusters(const Plant::Clusters& clusters, const MeshletBuilder::CullParameter& param, const ObjectInstance& instance,
+								eastl::vector<ObjectInstance>& out)
+{
+	_visibleClusters.clear();
+	MeshletBuilder::cull(clusters.meshlets, param, _visibleClusters);
+
+	// one draw per range of consecutive visible clusters
+	for (const auto& range : MeshletBuilder::drawRanges(clusters.meshlets, _visibleClusters))
+	{
+		_clusterDraws.push_back(*clusters.mesh);
+		_clusterDraws.back().setOffset(range.firstIndex);
+		_clusterDraws.back().setNumIndices(range.nbIndices);
+		out.push_back({ &_clusterDraws.back(), instance.tranform, instance.parameter });
 	}
 }
 
 namespace
 {
+	/* ratio of the triangles kept by each lod, a lod becomes acceptable at the distance where its error
+	   is seen as LOD_PIXEL_ERROR pixels on a 1080p screen with the default 70 degrees fov */
+	const eastl::vector<float> LOD_TRIANGLE_RATIOS = { 1, 0.5f, 0.2f, 0.08f };
+	const float LOD_PIXEL_ERROR = 2;
+	const float REFERENCE_SCREEN_HEIGHT = 1080;
+	const float REFERENCE_FOV = toRad(70);
+	const float LOD_ERROR_PER_DISTANCE = TubeMesher::worldError(LOD_PIXEL_ERROR, 1, REFERENCE_FOV, REFERENCE_SCREEN_HEIGHT);
+
+	/* adaptive branch tessellation of the first lod, for the closest distance a tree is seen from */
+	const float TREE_CLOSEST_DISTANCE = 1;
+	const float TRUNK_MESH_ERROR = TubeMesher::worldError(LOD_PIXEL_ERROR, TREE_CLOSEST_DISTANCE, REFERENCE_FOV, REFERENCE_SCREEN_HEIGHT);
+
+	/* generated trees are kept between runs, bump the version when the generation changes */
+	const int TREE_CACHE_VERSION = 7;
+	const char* TREE_CACHE_DIRECTORY = "cache/";
+
 	LTree::PredefinedTree randPredefFrom(int sizeCategorie, int r)
 	{
 		switch (sizeCategorie)
@@ -46,15 +115,62 @@ namespace
 	}
 }
 
+void PlanetPlants::addStage(const TaskGraph::StageFun& fun)
+{
+	_lastStage = { _generation.add(fun, _lastStage) };
+}
+
 void PlanetPlants::createTree(int sizeCategorie, int nb)
 {
-	auto baseParam = genRandParam(_seed++, sizeCategorie);
-	LeafGenerator::Parameter leafParam = LeafGenerator::Parameter::gen(_seed++, sizeCategorie);
+	const int seed = _seed;
+	_seed += 2 + nb * 2;
+	addStage([=](const CancelToken& token) { generateTrees(sizeCategorie, nb, seed, token); });
+}
+
+void PlanetPlants::populatePlant(Planet& planet, size_t plantIndex, int nbPlants)
+{
+	const int seed = _seed++;
+	addStage([=, &planet](const CancelToken& token)
+	{
+		if (token.wait(planet.surfaceBaked()))
+			placePlants(planet, plantIndex, nbPlants, seed, token);
+	});
+}
+
+void PlanetPlants::generateTrees(int sizeCategorie, int nb, int seed, const CancelToken& token)
+{
+	const int paramSeed = seed;
+	auto baseParam = genRandParam(seed++, sizeCategorie);
+	LeafGenerator::Parameter leafParam = LeafGenerator::Parameter::gen(seed++, sizeCategorie);
+
+	eastl::vector<MeshFile> trees(nb);
+	eastl::vector<char> generated(nb, 0);
+	eastl::vector<int> seeds(nb * 2);
+	for (auto& s : seeds)
+		s = seed++;
+
+	Chrono timer;
 
-	for (int i = 0; i < nb; ++i)
+	// trees are independent, load or generate them in parallel
+	parallelFor(uint(nb), [&](uint i)
 	{
-		LTree treeGenerator(baseParam.alterate(_seed++, 0.1f), _seed++);
-		UVMesh tree = treeGenerator.generateUVMesh(8);
+		if (token.isCancelled())
+			return;
+
+		const int key[] = { TREE_CACHE_VERSION, paramSeed, sizeCategorie, seeds[i * 2], seeds[i * 2 + 1] };
+		uint64_t hash = MeshFile::hash(key, sizeof(key));
+		hash = MeshFile::hash(LOD_TRIANGLE_RATIOS.data(), LOD_TRIANGLE_RATIOS.size() * sizeof(float), hash);
+
+		char path[64];
+		snprintf(path, sizeof(path), "%stree_%016llx.lmesh", TREE_CACHE_DIRECTORY, (unsigned long long)hash);
+
+		if (trees[i].open(path))
+			return;
+
+		// each tree alters its own copy, the trees are not altered cumulatively from each other as in a serial loop
+		LTree::Parameter treeParam = baseParam;
+		LTree treeGenerator(treeParam.alterate(seeds[i * 2], 0.1f), seeds[i * 2 + 1], LTree::PARALLEL);
+		UVMesh tree = treeGenerator.generateUVMesh(8, TRUNK_MESH_ERROR);
 		tree.computeNormals(true);
 
 		LeafGenerator genLeaf;
@@ -69,38 +185,110 @@ void PlanetPlants::createTree(int sizeCategorie, int nb)
 		genLeafParam.density = sizeCategorie == 1 ? 6:2;
 		genLeafParam.depth = 2;
 
-		MeshBuffers treeBuffer = MeshBuffers::createFromMesh(tree);
-		MeshBuffers leafTreeBuffer = MeshBuffers::createFromMesh(treeGenerator.generateLeaf(genLeafParam));
+		BaseMesh leaf = treeGenerator.generateLeaf(genLeafParam);
+
+		MeshSimplifier::Parameter simplifierParam;
+		eastl::vector<MeshSimplifier::Lod> lods[2] = { MeshSimplifier::generateLods(tree, LOD_TRIANGLE_RATIOS, simplifierParam),
+														MeshSimplifier::generateLods(leaf, LOD_TRIANGLE_RATIOS, simplifierParam) };
+
+		// the trunk goes first, its bounding sphere is the one of the plant
+		MeshFileWriter writer;
+		for (int part = 0; part < 2; ++part)
+		{
+			eastl::vector<MeshFileWriter::Lod> partLods;
+			for (auto& lod : lods[part])
+			{
+				MeshOptimizer::optimize(lod.mesh);
+				partLods.push_back({ &lod.mesh, lod.error });
+			}
+			writer.addPart(partLods, MeshFileWriter::PartParameter());
+		}
+
+		auto data = writer.serialize();
+		MeshFileWriter::write(path, data);
+		trees[i].open(eastl::move(data));
+		generated[i] = 1;
+	});
+
+	LOG("Created ", nb, " trees with ", LOD_TRIANGLE_RATIOS.size(), " lods in ", timer.elapsed().to_secs(), "s, ",
+		nb - eastl::count(generated.begin(), generated.end(), 1), " from the cache");
+
+	if (token.isCancelled())
+		return;
+
+	for (auto& t : trees)
+	{
+		if (t.nbParts() != 2)
+			continue;
+
+		auto trunk = MeshBuffers::createFromMeshFile(t.part(0));
+		auto leaf = MeshBuffers::createFromMeshFile(t.part(1));
 
 		Plant plant;
-		plant.lods.push_back({ { eastl::make_unique<MeshBuffers>(treeBuffer), eastl::make_unique<MeshBuffers>(leafTreeBuffer) }, 0 });
-		plant.boundingSphere = tree.computeBoundingSphere();
+		for (size_t lod = 0; lod < eastl::min(trunk.size(), leaf.size()); ++lod)
+		{
+			float error = eastl::max(t.part(0).lods[lod].error, t.part(1).lods[lod].error);
+
+			LOG("Tree lod ", lod, ": ", t.part(0).lods[lod].nbIndices / 3, " trunk triangles, ", t.part(1).lods[lod].nbIndices / 3, " leaf triangles, error ", error);
+
+			plant.lods.push_back({ { eastl::make_shared<MeshBuffers>(trunk[lod]), eastl::make_shared<MeshBuffers>(leaf[lod]) },
+								   lod == 0 ? 0 : error / LOD_ERROR_PER_DISTANCE });
+		}
+
+		if (plant.lods.empty())
+			continue;
+
+		plant.boundingSphere = t.part(0).boundingSphere;
+
+		// the clusters index the vertices of the first lod, as decoded by the shaders
+		for (uint part = 0; part < 2; ++part)
+		{
+			const MeshBuffers& lod = *plant.lods[0].meshs[part];
+			auto& clusters = plant.clusters[part];
+			clusters.meshlets = MeshletBuilder::build(MeshFile::extractMesh(t.part(part), 0));
+
+			const auto indices = clusters.meshlets.indexData();
+			if (indices.empty())
+				continue;
+
+			clusters.mesh = eastl::make_shared<MeshBuffers>(lod.vb(), MeshBuffers::createIndexBuffer(indices), 0, int64_t(indices.size()));
+			clusters.mesh->setBaseVertex(t.part(part).lods[0].firstVertex);
+			clusters.mesh->setDecode(lod.positionDecode(), lod.uvDecode());
+		}
 
 		std::lock_guard<std::mutex> _(_treeVectorMutex);
 		_plants.push_back(plant);
 	}
 }
 
-void PlanetPlants::populatePlant(Planet& planet, size_t plantIndex, int nbPlants)
+void PlanetPlants::placePlants(Planet& planet, size_t plantIndex, int nbPlants, int seed, const CancelToken&)
 {
 	_ASSERT(plantIndex < _plants.size());
 
-	std::mt19937 randEngine(_seed++);
+	std::mt19937 randEngine(seed);
 	std::uniform_real_distribution<float> random;
 
+	eastl::vector<vec3> dirs(nbPlants);
+	eastl::vector<Planet::SurfaceSample> samples(nbPlants);
 	for (int i = 0; i < nbPlants; ++i)
 	{
 		float u = (random(randEngine) - 0.5f) * 2;
 		float theta = random(randEngine) * 2 * PI;
 		float tmp = sqrtf(1.f - u*u);
-		vec3 pos(tmp * cosf(theta), tmp * sinf(theta), u);
+		dirs[i] = vec3(tmp * cosf(theta), tmp * sinf(theta), u);
+	}
 
-		vec3 translation = planet.evalNoise(pos);
+	planet.querySurface(dirs.data(), samples.data(), uint(nbPlants));
+
+	for (int i = 0; i < nbPlants; ++i)
+	{
+		vec3 translation = samples[i].position;
 
-		vec3 norm = -planet.evalNormal(pos);
-		norm = interpolate(pos.normalized(), norm, random(randEngine));
+		vec3 norm = -samples[i].normal;
+		norm = interpolate(dirs[i], norm, random(randEngine));
 
 		Instance inst;
+		inst.position = translation;
 		inst.transform = mat4::constructTransformation(mat3::changeBasis(norm)*mat3::RotationZ(random(randEngine)*PI * 2), 
 													   translation - norm*0.2f, vec3::construct(0.8f+random(randEngine)*0.4f)).transposed();
 		inst.indexPlant = plantIndex;
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <EASTL/deque.h>
 #include "Planet.h"
+#include "TaskGraph.h"
+#include "geometry/MeshletBuilder.h"
 #include "graphics/RendererStruct.h"
 
 class PlanetPlants
@@ -10,6 +13,8 @@ public:
 	
 	void cull(const tim::Camera&, eastl::vector<ObjectInstance>&, eastl::vector<ObjectInstance>&);
 
+	/* Queued on the thread pool, one after the other in the order of the calls, the plants are drawn once all are done.
+	   The instances are placed once the surface of the planet is baked, the destruction cancels what is left */
 	void createTree(int sizeCategorie, int number);
 	void populatePlant(Planet&, size_t plantIndex, int nbInstance);
 
@@ -28,6 +33,14 @@ private:
 		};
 		eastl::vector<Lod> lods;
 		Sphere boundingSphere;
+
+		/* The first lod of each part split in clusters, culled one by one, with its indices in the order of the clusters */
+		struct Clusters
+		{
+			tim::MeshletBuilder::Meshlets meshlets;
+			eastl::shared_ptr<MeshBuffers> mesh;
+		};
+		Clusters clusters[2];
 	};
 
 	std::mutex _treeVectorMutex;
@@ -36,9 +49,22 @@ private:
 	struct Instance
 	{
 		tim::mat4 transform;
+		tim::vec3 position;
 		MaterialParameter material[2];
 		size_t indexPlant;
 	};
 
 	eastl::vector<Instance> _instances;
+
+	eastl::deque<MeshBuffers> _clusterDraws; // the index ranges of the clusters drawn by the last cull
+	eastl::vector<tim::uint> _visibleClusters;
+
+	TaskGraph _generation; // destroyed first
+	eastl::vector<TaskGraph::Stage> _lastStage;
+
+private:
+	void generateTrees(int sizeCategorie, int number, int seed, const CancelToken&);
+	void placePlants(Planet&, size_t plantIndex, int nbInstance, int seed, const CancelToken&);
+	void cullClusters(const Plant::Clusters&, const tim::MeshletBuilder::CullParameter&, const ObjectInstance&, eastl::vector<ObjectInstance>&);
+	void addStage(const TaskGraph::StageFun&);
 };
\ No newline at end of file
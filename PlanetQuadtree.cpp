@@ -0,0 +1,774 @@
+#include "PlanetQuadtree.h"
+#include "Parallel.h"
+#include "geometry/GridBuilder.h"
+#include "geometry/MeshOptimizer.h"
+#include "geometry/MeshEncoder.h"
+#include "math/BoundingVolume.h"
+
+#include <EASTL/sort.h>
+
+#include <core/ctpl_stl.h>
+extern ctpl::thread_pool g_threadPool;
+
+using namespace tim;
+
+const uint PlanetQuadtree::NO_NODE;
+const uint PlanetQuadtree::MAX_LEVEL;
+const uint PlanetQuadtree::NB_STITCH_VARIANTS;
+const uint PlanetQuadtree::NODES_PER_PAGE;
+const uint PlanetQuadtree::MAX_PAGES;
+
+namespace
+{
+	const float MORPH_START = 0.7f; // fraction of the range where the morph starts
+	const float ERROR_DECAY = 0.5f; // estimated error of the next level relative to the morph deltas of a level
+	const float CONE_MARGIN = 0.1f; // radians, for the triangles along the stitched edges and in the middle of the morph
+
+	const uint BUILDS_PER_THREAD = 2; // in flight, so the pool always has the next one
+	const uint MAX_UPLOADS_PER_FRAME = 16;
+	const uint FRAMES_BEFORE_REUSE = 3; // of an evicted slot, the renderer has 2 frames in flight
+
+	// the culling tests still needed by a node, a node inside the volume of a test passes it with its whole subtree
+	enum CullTest { TEST_FRUSTUM = 1, TEST_HORIZON = 2, ALL_TESTS = 3 };
+
+	// bits of a stitch variant, the vertex (i,j) of a node is at its origin + (i,j) * size / resolution
+	enum Edge { EDGE_X0 = 1, EDGE_X1 = 2, EDGE_Y0 = 4, EDGE_Y1 = 8 };
+
+	/* The triangles of the grid with the odd vertices of the edges in the mask collapsed on the previous even vertex,
+	   the degenerated triangles are removed. Moving a vertex along a straight edge does not flip the other triangles. */
+	eastl::vector<uint> stitchedIndices(const eastl::vector<uint>& grid, uint resolution, uint mask)
+	{
+		const uivec2 res = { resolution + 1, resolution + 1 };
+		auto collapse = [&](uint v)
+		{
+			uint i = v / res.y(), j = v % res.y();
+			if (((mask & EDGE_X0) && i == 0) || ((mask & EDGE_X1) && i == resolution))
+				j -= j % 2;
+			if (((mask & EDGE_Y0) && j == 0) || ((mask & EDGE_Y1) && j == resolution))
+				i -= i % 2;
+			return GridBuilder::index(res, i, j);
+		};
+
+		BaseMesh mesh;
+		for (size_t t = 0; t + 2 < grid.size(); t += 3)
+		{
+			uint a = collapse(grid[t]), b = collapse(grid[t + 1]), c = collapse(grid[t + 2]);
+			if (a != b && b != c && c != a)
+				mesh.addFace({ { a, b, c, 0 }, 3 });
+		}
+
+		// the vertex layout is the one of every node, only the triangle order can change
+		MeshOptimizer::optimizeVertexCache(mesh);
+		return mesh.indexData();
+	}
+
+	/* Of the outward normals of the triangles over the given vertices */
+	void accumulateNormals(const eastl::vector<uint>& indices, const vec3* vertices, eastl::vector<vec3>& normals)
+	{
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const vec3& a = vertices[indices[t]];
+			vec3 normal = (vertices[indices[t + 1]] - a).cross(vertices[indices[t + 2]] - a);
+			if (normal.length2() == 0)
+				continue;
+
+			// a radial height field has no overhang
+			normal.normalize();
+			normals.push_back(normal.dot(a) < 0 ? -normal : normal);
+		}
+	}
+
+	float angleBetween(vec3 a, vec3 b)
+	{
+		return acosf(eastl::min(1.f, eastl::max(-1.f, a.dot(b))));
+	}
+}
+
+PlanetQuadtree::PlanetQuadtree(uint resolution, const PlanetHeightmap& heightmap)
+	: _resolution(eastl::max(2u, resolution + resolution % 2)), _heightmap(heightmap), _warp(heightmap.warp()),
+	_surface([this](vec3 dir) { return _heightmap.position(dir); })
+{
+
+	for (auto& error : _levelError)
+		error.store(0);
+	_occluderRadius.store(std::numeric_limits<float>::max());
+
+	for (uint face = 0; face < CubeSphere::NB_FACES; ++face)
+	{
+		_nodes.push_back();
+		_nodes.back().face = face;
+	}
+}
+
+PlanetQuadtree::~PlanetQuadtree()
+{
+	for (uint index : _building)
+		_nodes[index].cancelled.store(true);
+
+	std::unique_lock<std::mutex> lock(_buildsMutex);
+	_buildsFinished.wait(lock, [this]() { return _nbBuildsInFlight.load() == 0; });
+}
+
+void PlanetQuadtree::buildRoots()
+{
+	GridBuilder::Parameter gridParam;
+	gridParam.resolution = { _resolution + 1, _resolution + 1 };
+	gridParam.invertFaces = true;
+	gridParam.withUV = false;
+
+	BaseMesh grid;
+	GridBuilder::build(grid, gridParam);
+	const auto gridIndices = grid.indexData();
+
+	// the roots span less than the diameter of the planet in each axis
+	float maxRadius = 0;
+	for (uint face = 0; face < CubeSphere::NB_FACES; ++face)
+		maxRadius = eastl::max(maxRadius, _heightmap.radiusRange(face, vec2(0, 0), 1).y());
+	_latticeStep = MeshEncoder::latticeStep(maxRadius * 2);
+
+	eastl::vector<uint> indices;
+	for (uint mask = 0; mask < NB_STITCH_VARIANTS; ++mask)
+	{
+		auto variant = stitchedIndices(gridIndices, _resolution, mask);
+		_stitchOffset[mask] = uint(indices.size());
+		_stitchNbIndices[mask] = uint(variant.size());
+		indices.insert(indices.end(), variant.begin(), variant.end());
+	}
+
+	uint64_t fence = 0;
+	_indices = MeshBuffers::createIndexBuffer(indices, &fence);
+	dx12::g_commandQueues->waitForFence(fence);
+
+	for (uint face = 0; face < CubeSphere::NB_FACES; ++face)
+	{
+		_nodes[face].state.store(BUILDING);
+		_nodes[face].listed = true;
+		_building.push_back(face);
+	}
+
+	parallelFor(CubeSphere::NB_FACES, [&](uint face) { buildNode(_nodes[face]); }, 1);
+	uploadNodes(true);
+
+	_ready.store(true, std::memory_order_release);
+}
+
+void PlanetQuadtree::snapBorder(BaseMesh& mesh, const Node& node) const
+{
+	// the indices of the vertices on the grid of the level over the whole face
+	const uint n = _resolution + 1;
+	const uint scale = 1u << node.level;
+	const uint firstX = uint(node.origin.x() * scale + 0.5f) * _resolution, firstY = uint(node.origin.y() * scale + 0.5f) * _resolution;
+
+	uint index = 0;
+	mesh.mapVertices([&](vec3 v)
+	{
+		const uint i = index / n, j = index % n;
+		++index;
+		if (i != 0 && i != _resolution && j != 0 && j != _resolution)
+			return v;
+
+		// the vertex is on the grid of the parent when both its indices are even
+		uint x = firstX + i, y = firstY + j, level = node.level;
+		while (level > 0 && x % 2 == 0 && y % 2 == 0)
+		{
+			x /= 2;
+			y /= 2;
+			--level;
+		}
+
+		const float step = ldexpf(_latticeStep, -int(level));
+		return vec3(roundf(v.x() / step), roundf(v.y() / step), roundf(v.z() / step)) * step;
+	});
+}
+
+void PlanetQuadtree::buildNode(Node& node)
+{
+	// checked before the sampling of the surface and before the encoding, the node is not touched once it is EMPTY
+	if (node.cancelled.load())
+	{
+		node.state.store(EMPTY, std::memory_order_release);
+		return;
+	}
+
+	BaseMesh mesh;
+	eastl::vector<float> morphDelta;
+	CubeSphere::buildPatch(mesh, morphDelta, node.face, node.origin, node.size, _resolution, _warp, _surface);
+	snapBorder(mesh, node);
+
+	if (node.cancelled.load())
+	{
+		node.state.store(EMPTY, std::memory_order_release);
+		return;
+	}
+
+	float maxDelta = 0;
+	for (float d : morphDelta)
+		maxDelta = eastl::max(maxDelta, fabsf(d));
+
+	// the morph target of each vertex, the roots do not morph
+	eastl::vector<vec3> targets(mesh.nbVertices());
+	for (uint i = 0; i < mesh.nbVertices(); ++i)
+		targets[i] = node.level == 0 ? mesh.vertex(i) : mesh.vertex(i) + mesh.vertex(i).normalized() * morphDelta[i];
+
+	// the horizon bounds, the triangles are below their vertices by the sagitta of the cells, a cell spans 3*step radians at most whatever the warp
+	const float sagitta = cosf(1.5f * node.size / _resolution);
+	node.direction = CubeSphere::direction(node.face, node.origin + vec2::construct(node.size * 0.5f), _warp);
+	node.capAngle = 0;
+	node.minRadius = std::numeric_limits<float>::max();
+	node.maxRadius = 0;
+	for (uint i = 0; i < mesh.nbVertices(); ++i)
+	{
+		const float radius = mesh.vertex(i).length(), targetRadius = targets[i].length();
+		node.capAngle = eastl::max(node.capAngle, angleBetween(node.direction, mesh.vertex(i) / radius));
+		node.minRadius = eastl::min(node.minRadius, eastl::min(radius, targetRadius));
+		node.maxRadius = eastl::max(node.maxRadius, eastl::max(radius, targetRadius));
+	}
+	node.minRadius *= sagitta;
+	lowerOccluderRadius(node.minRadius);
+
+	// the normal cone covers the patch and its morph target
+	const auto gridIndices = mesh.indexData();
+	eastl::vector<vec3> normals;
+	accumulateNormals(gridIndices, mesh.vertexData(), normals);
+	accumulateNormals(gridIndices, targets.data(), normals);
+
+	vec3 axis;
+	for (const vec3& n : normals)
+		axis += n;
+	node.coneAxis = axis.length2() > 0 ? axis.normalized() : node.direction;
+	node.coneAngle = 0;
+	for (const vec3& n : normals)
+		node.coneAngle = eastl::max(node.coneAngle, angleBetween(node.coneAxis, n));
+	node.coneAngle += CONE_MARGIN;
+
+	// 0.5 does not move, the instance scales the deltas back
+	for (float& d : morphDelta)
+		d = maxDelta > 0 ? 0.5f + 0.5f * d / maxDelta : 0.5f;
+
+	// a node steeper than its level loses the shared lattice, and may crack by a step along its edges
+	float step = ldexpf(_latticeStep, -int(node.level));
+	while (!MeshEncoder::encodeOnLattice(mesh, MeshEncoder::Parameter(), step, node.encoded))
+		step *= 2;
+	MeshEncoder::setPositionW(node.encoded, morphDelta.data());
+
+	// the morph moves the vertices on the segments to their targets, inside the hull of both
+	targets.insert(targets.end(), mesh.vertexData(), mesh.vertexData() + mesh.nbVertices());
+	node.bounds = BoundingVolume::minimalSphere(reinterpret_cast<const float*>(targets.data()), uint(targets.size()));
+	node.maxMorphDelta = maxDelta;
+
+	if (node.level > 0)
+		raiseLevelError(node.level - 1, maxDelta);
+	raiseLevelError(node.level, maxDelta * ERROR_DECAY);
+
+	node.state.store(ENCODED, std::memory_order_release);
+}
+
+void PlanetQuadtree::raiseLevelError(uint level, float error)
+{
+	float current = _levelError[level].load();
+	while (error > current && !_levelError[level].compare_exchange_weak(current, error));
+}
+
+void PlanetQuadtree::lowerOccluderRadius(float radius)
+{
+	float current = _occluderRadius.load();
+	while (radius < current && !_occluderRadius.compare_exchange_weak(current, radius));
+}
+
+uint PlanetQuadtree::allocateSlot()
+{
+	// the slots of the evicted nodes are reused once the gpu is done with the frames drawing them
+	size_t nbRetired = 0;
+	for (const auto& retired : _retiredSlots)
+	{
+		if (_frame - retired.second >= FRAMES_BEFORE_REUSE)
+			_freeSlots.push_back(retired.first);
+		else
+			_retiredSlots[nbRetired++] = retired;
+	}
+	_retiredSlots.resize(nbRetired);
+
+	if (_freeSlots.empty())
+	{
+		if (_vertexPages.size() == MAX_PAGES)
+		{
+			// enough slots on their way back for the uploads of a frame
+			while (_retiredSlots.size() < MAX_UPLOADS_PER_FRAME && evictLeastRecentlyUsed());
+			return NO_NODE;
+		}
+
+		const uint verticesPerNode = (_resolution + 1) * (_resolution + 1);
+		const uint stride = MeshEncoder::vertexStride(MeshEncoder::Parameter());
+		_vertexPages.push_back(eastl::make_shared<dx12::GpuBuffer>(NODES_PER_PAGE * verticesPerNode, stride));
+
+		const uint firstSlot = (uint(_vertexPages.size()) - 1) * NODES_PER_PAGE;
+		for (uint i = NODES_PER_PAGE; i > 0; --i)
+			_freeSlots.push_back(firstSlot + i - 1);
+	}
+
+	const uint slot = _freeSlots.back();
+	_freeSlots.pop_back();
+	return slot;
+}
+
+bool PlanetQuadtree::evictLeastRecentlyUsed()
+{
+	// the groups of children which are all READY or EMPTY, without children of their own, not used by the last 2 selections
+	uint oldest = NO_NODE, oldestFrame = _frame - 1;
+	for (uint index = 0; index < uint(_nodes.size()); ++index)
+	{
+		const Node& node = _nodes[index];
+		if (node.children == NO_NODE || node.requestedFrame + 1 >= _frame || childrenEmpty(node))
+			continue;
+
+		bool evictable = true;
+		uint lastVisit = 0;
+		for (uint i = 0; i < 4 && evictable; ++i)
+		{
+			const Node& child = _nodes[node.children + i];
+			const int state = child.state.load(std::memory_order_acquire);
+			evictable = (state == READY || state == EMPTY) && (child.children == NO_NODE || childrenEmpty(child));
+			lastVisit = eastl::max(lastVisit, child.visitedFrame);
+		}
+
+		if (evictable && lastVisit < oldestFrame)
+		{
+			oldest = index;
+			oldestFrame = lastVisit;
+		}
+	}
+
+	if (oldest == NO_NODE)
+		return false;
+
+	for (uint i = 0; i < 4; ++i)
+	{
+		Node& child = _nodes[_nodes[oldest].children + i];
+		if (child.state.load() != READY)
+			continue;
+
+		_retiredSlots.push_back({ child.slot, _frame });
+		child.slot = NO_NODE;
+		child.mesh = MeshBuffers();
+		child.state.store(EMPTY);
+	}
+	return true;
+}
+
+void PlanetQuadtree::uploadNodes(bool wait)
+{
+	const uint verticesPerNode = (_resolution + 1) * (_resolution + 1);
+	dx12::CommandContext* commandContext = nullptr;
+	eastl::vector<uint> uploaded;
+
+	for (uint index : _building)
+	{
+		Node& node = _nodes[index];
+		if (node.state.load(std::memory_order_acquire) != ENCODED)
+			continue;
+
+		if (!wait && uploaded.size() == MAX_UPLOADS_PER_FRAME)
+			break;
+
+		const uint slot = allocateSlot();
+		if (slot == NO_NODE)
+			break;
+
+		if (!commandContext)
+			commandContext = &dx12::CommandContext::AllocContext(dx12::CommandQueue::COPY);
+
+		node.slot = slot;
+		const auto& page = _vertexPages[node.slot / NODES_PER_PAGE];
+		const uint firstVertex = (node.slot % NODES_PER_PAGE) * verticesPerNode;
+
+		commandContext->initBuffer(*page, node.encoded.vertexData.data(), node.encoded.vertexData.size(), size_t(firstVertex) * node.encoded.stride);
+
+		node.mesh = MeshBuffers(page, _indices, _stitchOffset[0], _stitchNbIndices[0]);
+		node.mesh.setBaseVertex(firstVertex);
+		node.mesh.setDecode(node.encoded);
+		node.encoded = MeshEncoder::EncodedMesh();
+		node.state.store(UPLOADING);
+		uploaded.push_back(index);
+	}
+
+	if (commandContext)
+	{
+		const uint64_t fence = commandContext->finish(wait);
+		for (uint index : uploaded)
+			_nodes[index].fence = fence;
+	}
+
+	size_t nbBuilding = 0;
+	for (uint index : _building)
+	{
+		Node& node = _nodes[index];
+		const int state = node.state.load(std::memory_order_acquire);
+		if (state == UPLOADING && (wait || dx12::g_commandQueues->isFenceComplete(node.fence)))
+		{
+			node.state.store(READY, std::memory_order_release);
+			node.listed = false;
+		}
+		else if (state == EMPTY) // cancelled
+			node.listed = false;
+		else
+			_building[nbBuilding++] = index;
+	}
+	_building.resize(nbBuilding);
+}
+
+bool PlanetQuadtree::childrenReady(const Node& node) const
+{
+	if (node.children == NO_NODE)
+		return false;
+
+	for (uint i = 0; i < 4; ++i)
+	{
+		if (_nodes[node.children + i].state.load(std::memory_order_acquire) != READY)
+			return false;
+	}
+	return true;
+}
+
+bool PlanetQuadtree::childrenEmpty(const Node& node) const
+{
+	for (uint i = 0; i < 4; ++i)
+	{
+		if (_nodes[node.children + i].state.load(std::memory_order_acquire) != EMPTY)
+			return false;
+	}
+	return true;
+}
+
+void PlanetQuadtree::requestChildren(uint index, float priority)
+{
+	_nodes[index].requestedFrame = _frame;
+	_requests.push_back({ index, priority });
+
+	if (_nodes[index].children != NO_NODE)
+		return;
+
+	_nodes[index].children = uint(_nodes.size());
+
+	const Node& node = _nodes[index];
+	const float childSize = node.size * 0.5f;
+
+	for (uint i = 0; i < 4; ++i)
+	{
+		_nodes.push_back();
+		Node& child = _nodes.back();
+
+		child.face = node.face;
+		child.level = node.level + 1;
+		child.origin = node.origin + vec2(float(i & 1), float(i >> 1)) * childSize;
+		child.size = childSize;
+		child.parent = index;
+	}
+}
+
+void PlanetQuadtree::scheduleBuilds()
+{
+	// the builds for the parents not requested anymore stop at their next stage, the nodes waiting for their upload are dropped
+	for (uint index : _building)
+	{
+		Node& node = _nodes[index];
+		if (node.parent == NO_NODE || _nodes[node.parent].requestedFrame == _frame)
+			continue;
+
+		const int state = node.state.load(std::memory_order_acquire);
+		if (state == BUILDING)
+			node.cancelled.store(true);
+		else if (state == ENCODED)
+		{
+			node.encoded = MeshEncoder::EncodedMesh();
+			node.state.store(EMPTY);
+		}
+	}
+
+	eastl::sort(_requests.begin(), _requests.end(), [](const Request& a, const Request& b) { return a.priority > b.priority; });
+
+	const uint maxBuilds = eastl::max(1u, uint(g_threadPool.size()) * BUILDS_PER_THREAD);
+	for (const Request& request : _requests)
+	{
+		for (uint i = 0; i < 4; ++i)
+		{
+			const uint index = _nodes[request.parent].children + i;
+			Node& child = _nodes[index];
+
+			// a build cancelled by a previous selection goes on if it has not seen it yet
+			child.cancelled.store(false);
+			if (child.state.load(std::memory_order_acquire) != EMPTY)
+				continue;
+
+			if (_nbBuildsInFlight.load() >= maxBuilds)
+				return;
+
+			child.state.store(BUILDING);
+			if (!child.listed)
+			{
+				child.listed = true;
+				_building.push_back(index);
+			}
+
+			++_nbBuildsInFlight;
+			g_threadPool.push([this, &child](int)
+			{
+				buildNode(child);
+
+				std::lock_guard<std::mutex> _(_buildsMutex);
+				--_nbBuildsInFlight;
+				_buildsFinished.notify_all();
+			});
+		}
+	}
+}
+
+void PlanetQuadtree::select(const View& view, eastl::vector<ObjectInstance>& instances)
+{
+	if (!isReady())
+		return;
+
+	uploadNodes(false);
+
+	++_frame;
+	_selected.clear();
+	_drawn.clear();
+	_requests.clear();
+	_cullStats = CullStats();
+
+	for (uint face = 0; face < CubeSphere::NB_FACES; ++face)
+		selectNode(view, face, 0, ALL_TESTS);
+
+	balanceSelection();
+
+	for (uint index : _selected)
+		drawNode(view, index, instances);
+
+	scheduleBuilds();
+}
+
+void PlanetQuadtree::selectNode(const View& view, uint index, float morphEnd, uint tests)
+{
+	Node& node = _nodes[index];
+	++_cullStats.visited;
+
+	if (tests & TEST_FRUSTUM)
+	{
+		const Sphere subtree(node.bounds.center() + view.offset, node.bounds.radius() + subtreeMargin(node));
+		const Frustum::Intersection inter = view.frustum->collide(subtree);
+		if (inter == Frustum::OUTSIDE)
+		{
+			++_cullStats.frustumCulled;
+			return;
+		}
+		if (inter == Frustum::INSIDE)
+			tests &= ~TEST_FRUSTUM;
+	}
+	else
+		++_cullStats.frustumSkipped;
+
+	if (tests & TEST_HORIZON)
+	{
+		const Frustum::Intersection inter = horizonTest(view, node);
+		if (inter == Frustum::OUTSIDE)
+		{
+			++_cullStats.horizonCulled;
+			return;
+		}
+		if (inter == Frustum::INSIDE)
+			tests &= ~TEST_HORIZON;
+	}
+	else
+		++_cullStats.horizonSkipped;
+
+	node.visitedFrame = _frame;
+	node.morphEnd = morphEnd;
+	const float distance = eastl::max(0.f, (node.bounds.center() - view.position).length() - node.bounds.radius());
+	const float error = _levelError[node.level].load();
+
+	if (node.level < MAX_LEVEL && error > view.errorPerDistance * distance)
+	{
+		if (childrenReady(node))
+		{
+			// the children take the shape of this node where it is not split anymore
+			const float childMorphEnd = error / view.errorPerDistance;
+			for (uint i = 0; i < 4; ++i)
+				selectNode(view, node.children + i, childMorphEnd, tests);
+			return;
+		}
+
+		// the ratio of the error of the level to the one allowed at this distance
+		requestChildren(index, error / eastl::max(view.errorPerDistance * distance, 1e-6f));
+	}
+
+	node.drawnFrame = _frame;
+	_selected.push_back(index);
+}
+
+void PlanetQuadtree::balanceSelection()
+{
+	// a parent taking the place of its children can leave its other neighbours two levels finer in turn
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (uint index : _selected)
+		{
+			const Node& node = _nodes[index];
+			for (uint edge = 0; edge < 4; ++edge)
+			{
+				const uint level = neighbourLevel(node, edge);
+				if (level != NO_NODE && level + 1 < node.level)
+				{
+					Node& parent = _nodes[node.parent];
+					if (parent.drawnFrame != _frame)
+					{
+						parent.drawnFrame = _frame;
+						++_cullStats.balanced;
+					}
+					changed = true;
+					break;
+				}
+			}
+		}
+
+		if (changed)
+		{
+			// the nodes under a selected parent are not reached anymore
+			_selected.clear();
+			for (uint face = 0; face < CubeSphere::NB_FACES; ++face)
+				collectSelected(face);
+		}
+	}
+}
+
+void PlanetQuadtree::collectSelected(uint index)
+{
+	const Node& node = _nodes[index];
+	if (node.visitedFrame != _frame)
+		return;
+
+	if (node.drawnFrame == _frame)
+	{
+		_selected.push_back(index);
+		return;
+	}
+
+	for (uint i = 0; i < 4; ++i)
+		collectSelected(node.children + i);
+}
+
+void PlanetQuadtree::drawNode(const View& view, uint index, eastl::vector<ObjectInstance>& instances)
+{
+	// still selected for the stitching of its neighbours
+	Node& node = _nodes[index];
+	if (isBackFacing(view, node))
+	{
+		++_cullStats.backFacing;
+		return;
+	}
+
+	const uint mask = stitchMask(node);
+	node.mesh.setOffset(_stitchOffset[mask]);
+	node.mesh.setNumIndices(_stitchNbIndices[mask]);
+
+	// the roots have no morph
+	MaterialParameter material;
+	material.parameter = vec4(node.morphEnd * MORPH_START, node.morphEnd, node.maxMorphDelta, 0);
+	instances.push_back({ &node.mesh, mat4::Translation(view.offset), material });
+
+	_drawn.push_back(index);
+	++_cullStats.drawn;
+}
+
+float PlanetQuadtree::subtreeMargin(const Node& node) const
+{
+	// the children can go beyond the node by the error of the next levels
+	return _levelError[node.level].load() / (1 - ERROR_DECAY);
+}
+
+Frustum::Intersection PlanetQuadtree::horizonTest(const View& view, const Node& node) const
+{
+	const float occluder = _occluderRadius.load();
+	const float cameraRadius = view.position.length();
+	if (cameraRadius <= occluder)
+		return Frustum::INTERSECT;
+
+	// a point at a radius r is seen up to acos(R/h) + acos(R/r) from the direction of the camera, acos(R/h) whatever r
+	const float maxRadius = node.maxRadius + subtreeMargin(node);
+	const float horizon = acosf(occluder / cameraRadius);
+	const float angle = angleBetween(node.direction, view.position / cameraRadius);
+
+	if (angle - node.capAngle > horizon + acosf(eastl::min(1.f, occluder / maxRadius)))
+		return Frustum::OUTSIDE;
+	return angle + node.capAngle <= horizon ? Frustum::INSIDE : Frustum::INTERSECT;
+}
+
+bool PlanetQuadtree::isBackFacing(const View& view, const Node& node) const
+{
+	if (node.coneAngle >= PI * 0.5f)
+		return false;
+
+	// a triangle is seen if its outward normal points to the camera from one of its points, bounded by the sphere
+	const vec3 toCamera = view.position - node.bounds.center();
+	const float distance = toCamera.length();
+	if (distance <= node.bounds.radius())
+		return false;
+
+	// the largest projection of a normal of the cone on the direction of the camera
+	const float angle = angleBetween(node.coneAxis, toCamera / distance);
+	if (angle <= node.coneAngle)
+		return false;
+
+	return distance * cosf(angle - node.coneAngle) < -node.bounds.radius();
+}
+
+uint PlanetQuadtree::stitchMask(const Node& node) const
+{
+	if (node.level == 0)
+		return 0;
+
+	// the selection is balanced, a coarser neighbour is one level above
+	const uint edges[4] = { EDGE_X0, EDGE_X1, EDGE_Y0, EDGE_Y1 };
+
+	uint mask = 0;
+	for (uint e = 0; e < 4; ++e)
+	{
+		const uint level = neighbourLevel(node, e);
+		if (level != NO_NODE && level < node.level)
+			mask |= edges[e];
+	}
+	return mask;
+}
+
+uint PlanetQuadtree::neighbourLevel(const Node& node, uint edge) const
+{
+	// inside the neighbour of the same level, whatever the orientation of its face
+	const float inside = node.size * 0.25f, middle = node.size * 0.5f;
+	const vec2 samples[4] = { node.origin + vec2(-inside, middle), node.origin + vec2(node.size + inside, middle),
+							  node.origin + vec2(middle, -inside), node.origin + vec2(middle, node.size + inside) };
+
+	vec2 coord = samples[edge];
+	uint face = node.face;
+	if (coord.x() < 0 || coord.x() > 1 || coord.y() < 0 || coord.y() > 1)
+		face = CubeSphere::locate(CubeSphere::cubePoint(node.face, samples[edge], _warp), coord, _warp);
+
+	return drawnLevel(face, coord);
+}
+
+uint PlanetQuadtree::drawnLevel(uint face, vec2 coord) const
+{
+	uint index = face;
+	for (;;)
+	{
+		const Node& node = _nodes[index];
+		if (node.visitedFrame != _frame)
+			return NO_NODE;
+		if (node.drawnFrame == _frame)
+			return node.level;
+		if (node.children == NO_NODE)
+			return NO_NODE;
+
+		const vec2 local = (coord - node.origin) / node.size;
+		index = node.children + (local.x() >= 0.5f ? 1 : 0) + (local.y() >= 0.5f ? 2 : 0);
+	}
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <EASTL/deque.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "geometry/CubeSphere.h"
+#include "PlanetHeightmap.h"
+#include "math/Sphere.h"
+#include "math/Frustum.h"
+#include "graphics\Graphics.h"
+
+/* Continuous level of detail (CDLOD) of the planet, a quadtree on each face of the cube sphere.
+   A node is a patch of resolution x resolution quads over its square of the face. The nodes share the index buffer,
+   only their vertices are generated, on the thread pool, when they are needed.
+   Every level samples the surface from the heightmap of the planet, as its surface queries, so what is drawn up close
+   is what the plants and the grass stand on. The levels finer than the texels interpolate them bilinearly.
+   The vertices of the nodes are in pages of NODES_PER_PAGE slots, a node being drawn with the base vertex of its slot.
+   The tasks only encode the vertices, select uploads the nodes encoded since the previous frame with one copy,
+   the pages being written by one thread.
+
+   The geometric error of a level is the largest distance between a patch of the next level and its half resolution grid,
+   which is exactly the part of the parent covering it. It is estimated from the level itself until the next one is generated.
+   A node is split while the error of its level, seen from the camera at the distance of its bounds, is above the allowed error.
+   Its children replace it once the 4 of them are generated, so there is no hole while they are built.
+
+   The vertices of a node morph to the grid of its parent as the camera goes away, reaching it at the distance where the parent
+   stops being split, so the changes of level do not pop. The ranges are the same for a whole level so the common borders
+   of two nodes of the same level move together. The morph is radial: the delta of each vertex along its direction is
+   stored in the w component of its quantized position, the instance gives the range of the deltas (see g_planetShader).
+   The positions are quantized on a lattice shared by the whole planet, whose step is halved at each level, from the box
+   of the node snapped to it. A vertex on the border of a node is rounded to the lattice of the coarsest level having it,
+   so the nodes sharing it encode it the same and their common edges do not crack. It is as precise as in that coarsest node.
+
+   A node next to a coarser one, its children still being generated, would leave a crack along their common edge.
+   The shared index buffer holds 16 variants of the grid, one per set of edges where the odd vertices are collapsed
+   on their even neighbour so the edge matches the coarser grid. The variant of a node is chosen once the whole
+   selection is known, from the level of the node drawn across the middle of each edge, on the same face or not.
+   The variants only match a neighbour one level coarser, so the selection is balanced first: a node with a neighbour
+   two levels coarser or more, which can stay so while it is built or after it is evicted, is replaced by its parent,
+   ready since the selection went through it, until every node is within one level of its neighbours.
+
+   Besides the frustum, a node is culled when it is behind the horizon: the ball of the lowest radius generated so far
+   is inside the planet and hides everything beyond its tangent cone from the camera. A node is bounded by the cap of
+   directions around its center and its max radius, raised by the error of the finer levels as it also bounds its children.
+   A node to draw is also skipped when it is back facing, from the cone of its triangle normals, the morph included.
+   The frustum and horizon tests of a node hold for its subtree, so a node inside the frustum or in front of the horizon
+   passes the test for all its children, which are not tested again.
+
+   The generation is streamed: a selection requests the children of the nodes it wants to split, with the ratio of their
+   error to the allowed one as priority, so the nodes close to the camera come first. The most urgent requests are started
+   while the builds in flight stay under a few per thread, the others wait for the next selections. A build whose parent
+   is not requested anymore is cancelled at its next stage. A few nodes are uploaded per frame and the vertex pages are
+   bounded: once they are full, the 4 children of a node not visited by the last selections, the least recently visited,
+   are evicted and rebuilt if they are needed again. The tree itself is kept. */
+class PlanetQuadtree : NonCopyable
+{
+public:
+	struct View
+	{
+		const Frustum* frustum;
+		vec3 position; // of the camera, in the space of the planet
+		vec3 offset; // of the planet
+		float errorPerDistance; // allowed world space error at a unit distance
+	};
+
+	/* Of the last selection, a culled node is counted once, its children are not visited */
+	struct CullStats
+	{
+		tim::uint visited = 0;
+		tim::uint frustumCulled = 0, horizonCulled = 0, backFacing = 0;
+		tim::uint frustumSkipped = 0, horizonSkipped = 0; // the visited nodes with a parent already inside
+		tim::uint balanced = 0; // the nodes selected instead of their children to stay within one level of their neighbours
+		tim::uint drawn = 0;
+	};
+
+	/* The heightmap is the surface of the nodes and places them on the sphere with its warp, it is baked before buildRoots */
+	PlanetQuadtree(tim::uint resolution, const PlanetHeightmap&);
+
+	/* Cancel the builds in flight and wait for them */
+	~PlanetQuadtree();
+
+	/* Generate the shared indices and the roots, blocking */
+	void buildRoots();
+	bool isReady() const;
+
+	/* Append the nodes to draw, the missing children are requested to the thread pool */
+	void select(const View&, eastl::vector<ObjectInstance>&);
+
+	tim::uint nbNodes() const;
+	const CullStats& cullStats() const;
+
+private:
+	static const tim::uint NO_NODE = tim::uint(-1);
+	static const tim::uint MAX_LEVEL = 10;
+	static const tim::uint NB_STITCH_VARIANTS = 16;
+	static const tim::uint NODES_PER_PAGE = 64;
+	static const tim::uint MAX_PAGES = 32;
+
+	enum State { EMPTY, BUILDING, ENCODED, UPLOADING, READY };
+
+	struct Node
+	{
+		tim::uint face = 0, level = 0;
+		vec2 origin; // in face coordinates
+		float size = 1;
+		tim::uint parent = NO_NODE, children = NO_NODE; // the 4 children are consecutive
+
+		std::atomic<int> state = { EMPTY };
+		std::atomic<bool> cancelled = { false }; // the task goes back to EMPTY
+		tim::uint visitedFrame = 0, drawnFrame = 0; // the last selections reaching the node and drawing it
+		float morphEnd = 0; // of the last selection reaching it
+		tim::uint requestedFrame = 0; // the last selection requesting its children
+		bool listed = false; // in _building
+
+		/* Written by the task generating the node, read once it is ENCODED */
+		Sphere bounds; // in the space of the planet, of the vertices and their morph targets
+		float maxMorphDelta = 0;
+		vec3 direction; // of the center of the square
+		float capAngle = 0; // between the direction and the farthest vertex
+		float minRadius = 0, maxRadius = 0; // the morph included
+		vec3 coneAxis; // outward
+		float coneAngle = 0; // above PI/2 the node is never back facing
+		tim::MeshEncoder::EncodedMesh encoded; // released once uploaded
+
+		/* Written by the upload */
+		tim::uint slot = NO_NODE;
+		uint64_t fence = 0;
+		MeshBuffers mesh;
+	};
+
+	const tim::uint _resolution;
+	const PlanetHeightmap& _heightmap;
+	const CubeSphere::Warp _warp;
+	CubeSphere::SurfaceFun _surface;
+
+	eastl::deque<Node> _nodes; // the roots first, in the order of the faces; the nodes do not move
+	std::atomic<float> _levelError[MAX_LEVEL + 1];
+	std::atomic<float> _occluderRadius; // the lowest min radius of the nodes
+	std::atomic<bool> _ready = { false };
+	float _latticeStep = 0; // of the roots, set before their builds
+
+	eastl::shared_ptr<dx12::GpuBuffer> _indices;
+	eastl::vector<eastl::shared_ptr<dx12::GpuBuffer>> _vertexPages;
+	eastl::vector<tim::uint> _freeSlots;
+	eastl::vector<eastl::pair<tim::uint, tim::uint>> _retiredSlots; // of the evicted nodes, with the frame of the eviction
+	eastl::vector<tim::uint> _building; // scheduled and not READY yet
+
+	struct Request
+	{
+		tim::uint parent;
+		float priority;
+	};
+	eastl::vector<Request> _requests; // of the last selection
+	std::atomic<tim::uint> _nbBuildsInFlight = { 0 }; // decremented under the mutex, the destructor waits for 0
+	std::mutex _buildsMutex;
+	std::condition_variable _buildsFinished;
+	tim::uint _stitchOffset[NB_STITCH_VARIANTS] = { 0 }, _stitchNbIndices[NB_STITCH_VARIANTS] = { 0 };
+
+	tim::uint _frame = 0;
+	eastl::vector<tim::uint> _selected; // the leaves of the selection, drawn unless back facing
+	eastl::vector<tim::uint> _drawn;
+	CullStats _cullStats;
+
+private:
+	void buildNode(Node&);
+	void snapBorder(tim::BaseMesh&, const Node&) const; // on the lattice of the coarsest level having each border vertex
+	void raiseLevelError(tim::uint level, float);
+	void lowerOccluderRadius(float);
+
+	tim::uint allocateSlot(); // NO_NODE if the pages are full
+	bool evictLeastRecentlyUsed();
+	void uploadNodes(bool wait);
+
+	bool childrenReady(const Node&) const;
+	bool childrenEmpty(const Node&) const;
+	void requestChildren(tim::uint node, float priority);
+	void scheduleBuilds();
+	void selectNode(const View&, tim::uint node, float morphEnd, tim::uint tests);
+	void balanceSelection();
+	void collectSelected(tim::uint node);
+	void drawNode(const View&, tim::uint node, eastl::vector<ObjectInstance>&);
+	float subtreeMargin(const Node&) const;
+	Frustum::Intersection horizonTest(const View&, const Node&) const; // INSIDE if the whole subtree is in front of it
+	bool isBackFacing(const View&, const Node&) const;
+
+	tim::uint stitchMask(const Node&) const;
+	tim::uint neighbourLevel(const Node&, tim::uint edge) const; // of the node drawn across the middle of the edge
+	tim::uint drawnLevel(tim::uint face, vec2 coord) const; // NO_NODE if nothing is drawn there
+};
+
+inline bool PlanetQuadtree::isReady() const { return _ready.load(std::memory_order_acquire); }
+inline tim::uint PlanetQuadtree::nbNodes() const { return tim::uint(_nodes.size()); }
+inline const PlanetQuadtree::CullStats& PlanetQuadtree::cullStats() const { return _cullStats; }
@@ -0,0 +1,123 @@
+#include "TaskGraph.h"
+
+#include <core/ctpl_stl.h>
+extern ctpl::thread_pool g_threadPool;
+
+namespace tim
+{
+
+namespace
+{
+	const auto CANCEL_POLL_PERIOD = std::chrono::milliseconds(2);
+}
+
+bool CancelToken::wait(const std::shared_future<void>& future) const
+{
+	while (future.wait_for(CANCEL_POLL_PERIOD) != std::future_status::ready)
+	{
+		if (isCancelled())
+			return false;
+	}
+	return !isCancelled();
+}
+
+TaskGraph::TaskGraph() : _state(eastl::make_shared<State>())
+{
+
+}
+
+TaskGraph::~TaskGraph()
+{
+	cancel();
+	wait();
+}
+
+TaskGraph::Stage TaskGraph::add(const StageFun& fun, const eastl::vector<Stage>& dependencies)
+{
+	std::unique_lock<std::mutex> lock(_state->mutex);
+
+	const Stage stage = Stage(_state->nodes.size());
+	_state->nodes.push_back();
+	Node& node = _state->nodes.back();
+	node.fun = fun;
+	node.future = node.promise.get_future().share();
+
+	for (Stage dependency : dependencies)
+	{
+		Node& parent = _state->nodes[dependency];
+		if (!parent.done)
+		{
+			parent.dependents.push_back(stage);
+			++node.nbPendingDependencies;
+		}
+	}
+
+	++_state->nbPending;
+	const bool ready = node.nbPendingDependencies == 0;
+	lock.unlock();
+
+	if (ready)
+		start(_state, stage);
+	return stage;
+}
+
+void TaskGraph::start(const eastl::shared_ptr<State>& state, Stage stage)
+{
+	g_threadPool.push([state, stage](int)
+	{
+		// the node does not move once added, its function is only touched by this task
+		Node* node;
+		{
+			std::lock_guard<std::mutex> _(state->mutex);
+			node = &state->nodes[stage];
+		}
+
+		if (!state->token.isCancelled())
+			node->fun(state->token);
+
+		eastl::vector<Stage> ready;
+		{
+			std::lock_guard<std::mutex> _(state->mutex);
+			node->done = true;
+			node->fun = nullptr;
+			node->promise.set_value();
+
+			for (Stage dependent : node->dependents)
+			{
+				if (--state->nodes[dependent].nbPendingDependencies == 0)
+					ready.push_back(dependent);
+			}
+
+			--state->nbPending;
+			state->finished.notify_all();
+		}
+
+		for (Stage dependent : ready)
+			start(state, dependent);
+	});
+}
+
+std::shared_future<void> TaskGraph::future(Stage stage) const
+{
+	std::lock_guard<std::mutex> _(_state->mutex);
+	return _state->nodes[stage].future;
+}
+
+bool TaskGraph::isDone() const
+{
+	std::lock_guard<std::mutex> _(_state->mutex);
+	return _state->nbPending == 0;
+}
+
+void TaskGraph::cancel()
+{
+	_state->token.cancel();
+}
+
+void TaskGraph::wait()
+{
+	std::unique_lock<std::mutex> lock(_state->mutex);
+	_state->finished.wait(lock, [this]() { return _state->nbPending == 0; });
+}
+
+}
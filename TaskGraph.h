@@ -0,0 +1,87 @@
+#pragma once
+
+#include <core/type.h>
+#include <core/NonCopyable.h>
+#include <EASTL/vector.h>
+#include <EASTL/deque.h>
+#include <EASTL/functional.h>
+#include <EASTL/shared_ptr.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+
+namespace tim
+{
+	/* Checked by the long loops of a task, between two units of work */
+	class CancelToken : NonCopyable
+	{
+	public:
+		CancelToken() = default;
+
+		void cancel();
+		bool isCancelled() const;
+
+		/* Wait for the future, false if the token is cancelled first */
+		bool wait(const std::shared_future<void>&) const;
+
+	private:
+		std::atomic<bool> _cancelled = { false };
+	};
+
+	inline void CancelToken::cancel() { _cancelled.store(true); }
+	inline bool CancelToken::isCancelled() const { return _cancelled.load(); }
+
+	/* Stages run on g_threadPool once the stages they depend on are done, a stage is started as soon as it is added
+	   if they already are. Each stage has a future set when it is done, cancelled or not.
+	   Once cancelled, the running stages see the token and the stages not started yet are skipped, their futures
+	   are still set so the stages waiting for them go on. The destructor cancels the graph and waits for its stages,
+	   so the objects captured by the stages can be destroyed right after it. */
+	class TaskGraph : NonCopyable
+	{
+	public:
+		using Stage = uint;
+		using StageFun = eastl::function<void(const CancelToken&)>;
+
+		TaskGraph();
+		~TaskGraph();
+
+		Stage add(const StageFun&, const eastl::vector<Stage>& dependencies = {});
+
+		std::shared_future<void> future(Stage) const;
+		bool isDone() const; // all the stages added
+		const CancelToken& token() const;
+
+		void cancel();
+		void wait();
+
+	private:
+		struct Node
+		{
+			StageFun fun;
+			eastl::vector<Stage> dependents;
+			uint nbPendingDependencies = 0;
+			bool done = false;
+			std::promise<void> promise;
+			std::shared_future<void> future;
+		};
+
+		/* Kept alive by the running stages */
+		struct State
+		{
+			mutable std::mutex mutex;
+			std::condition_variable finished;
+			eastl::deque<Node> nodes; // the nodes do not move
+			uint nbPending = 0;
+			CancelToken token;
+		};
+
+		eastl::shared_ptr<State> _state;
+
+	private:
+		static void start(const eastl::shared_ptr<State>&, Stage);
+	};
+
+	inline const CancelToken& TaskGraph::token() const { return _state->token; }
+}
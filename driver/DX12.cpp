@@ -41,15 +41,98 @@ namespace dx12
 	Texture2D<float4> textures[16] : register(t2);
 	SamplerState texSampler : register(s2);
 
+	struct Vertex
+	{
+		float3 position;
+		float3 normal;
+		float2 texCoord;
+	};
+
+	Vertex decodeVertex(VertexShaderInput input)
+	{
+		Vertex v;
+		v.position = input.vertex;
+		v.normal = input.normal;
+		v.texCoord = input.texCoord;
+		return v;
+	}
+
+	)";
+
+	/* Same interface as g_headerShader for the vertices encoded by MeshEncoder (OCT_SNORM16 normals) */
+	const char* g_quantizedHeaderShader = R"(
+	
+	struct VertexShaderInput 
+	{ 
+		float4 vertex : VERTEX; 
+		float2 normal : NORMAL;
+		float2 texCoord : UV; 
+
+		float4x4 model : MODEL_MATRIX;
+
+		int4 material_textures : MATERIAL_TEXTURES;
+		float4 material : MATERIAL;
+
+		float4 positionDecode : POSITION_DECODE;
+		float4 uvDecode : UV_DECODE;
+	};
+
+	struct PixelShaderInput 
+	{ 
+		float4 position : SV_POSITION;
+		float3 normal : OUT_NORMAL;
+		float2 texCoord : OUT_UV;
+
+		int4 textures : OUT_MATERIAL_TEXTURES;
+		float4 material : OUT_MATERIAL;
+	};
+
+	cbuffer FrameConstants : register(b0)
+	{
+		matrix <float, 4, 4> view;
+		matrix <float, 4, 4> proj;
+		matrix <float, 4, 4> projView;
+		float4 cameraPos;
+	};
+
+	Texture2D<float4> textures[16] : register(t2);
+	SamplerState texSampler : register(s2);
+
+	struct Vertex
+	{
+		float3 position;
+		float3 normal;
+		float2 texCoord;
+	};
+
+	float3 decodeOctahedral(float2 e)
+	{
+		float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+		float t = saturate(-n.z);
+		n.xy += n.xy >= 0 ? -t : t;
+		return normalize(n);
+	}
+
+	Vertex decodeVertex(VertexShaderInput input)
+	{
+		Vertex v;
+		v.position = input.vertex.xyz * input.positionDecode.w + input.positionDecode.xyz;
+		v.normal = decodeOctahedral(input.normal);
+		v.texCoord = input.texCoord * input.uvDecode.zw + input.uvDecode.xy;
+		return v;
+	}
+
 	)";
 
 	const char* g_defaultShader = R"(
 	PixelShaderInput vs_main(VertexShaderInput input)
 	{
+		Vertex v = decodeVertex(input);
+
 		PixelShaderInput output;
-		output.position = mul(projView, mul(input.model, float4(input.vertex, 1)));
-		output.normal = mul(float3x3(input.model._m00_m01_m02, input.model._m10_m11_m12, input.model._m20_m21_m22), input.normal);
-		output.texCoord = input.texCoord;
+		output.position = mul(projView, mul(input.model, float4(v.position, 1)));
+		output.normal = mul(float3x3(input.model._m00_m01_m02, input.model._m10_m11_m12, input.model._m20_m21_m22), v.normal);
+		output.texCoord = v.texCoord;
 
 		output.textures = input.material_textures;
 		output.material = input.material;
@@ -64,14 +147,25 @@ namespace dx12
 
 	)";
 
+	/* material: x,y the distances where the morph to the parent grid starts and ends (y=0 for no morph), z the largest delta,
+	   the radial delta of a vertex is in the w of its position, 0.5 being no delta */
 	const char* g_planetShader = R"(
 
 	PixelShaderInput vs_main(VertexShaderInput input)
 	{
+		Vertex v = decodeVertex(input);
+		float3 worldPos = mul(input.model, float4(v.position, 1)).xyz;
+
+		if (input.material.y > 0)
+		{
+			float morph = saturate((distance(worldPos, cameraPos.xyz) - input.material.x) / (input.material.y - input.material.x));
+			worldPos += normalize(v.position) * (input.vertex.w * 2 - 1) * input.material.z * morph;
+		}
+
 		PixelShaderInput output;
-		output.position = mul(projView, float4(input.vertex, 1));
-		output.normal = input.normal;
-		output.texCoord = input.texCoord;
+		output.position = mul(projView, float4(worldPos, 1));
+		output.normal = v.normal;
+		output.texCoord = v.texCoord;
 
 		output.textures = input.material_textures;
 		output.material = input.material;
@@ -91,13 +185,15 @@ namespace dx12
 	
 	struct VertexShaderInput 
 	{ 
-		float3 vertex : VERTEX; 
-		float3 normal : NORMAL;
+		float4 vertex : VERTEX; // quantized position, octahedral normal packed in w
 
 		float4x4 model : MODEL_MATRIX;
 
 		int4 material_textures : MATERIAL_TEXTURES;
 		float4 material : MATERIAL;
+
+		float4 positionDecode : POSITION_DECODE;
+		float4 uvDecode : UV_DECODE;
 	};
 
 	struct PixelShaderInput 
@@ -132,11 +228,26 @@ namespace dx12
 	Texture2D<float4> textures[16] : register(t2);
 	SamplerState texSampler : register(s2);
 	
+	float3 decodeOctahedral(float2 e)
+	{
+		float3 n = float3(e, 1 - abs(e.x) - abs(e.y));
+		float t = saturate(-n.z);
+		n.xy += n.xy >= 0 ? -t : t;
+		return normalize(n);
+	}
+
+	float2 unpackSnorm8x2(float packed)
+	{
+		uint bits = uint(packed * 65535 + 0.5);
+		int2 v = int2(int(bits << 24) >> 24, int(bits << 16) >> 24);
+		return max(float2(v) / 127.0, -1);
+	}
+
 	GeometryShaderInput vs_main(VertexShaderInput input)
 	{
 		GeometryShaderInput output;
-		output.vertex = input.vertex;
-		output.normal = input.normal;
+		output.vertex = input.vertex.xyz * input.positionDecode.w + input.positionDecode.xyz;
+		output.normal = decodeOctahedral(unpackSnorm8x2(input.vertex.w));
 
 		output.textures = input.material_textures;
 		output.material = input.material;
@@ -19,6 +19,7 @@ namespace dx12
 
 	extern const char* g_defaultShader;
 	extern const char* g_headerShader;
+	extern const char* g_quantizedHeaderShader;
 	extern const char* g_planetShader;
 	extern const char* g_grassShader;
 }
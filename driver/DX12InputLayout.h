@@ -62,6 +62,33 @@ namespace dx12
 			setupName();
 		}
 
+		void initWithFormats(const eastl::vector<eastl::pair<eastl::string, DXGI_FORMAT>>& layout) // (name , format), for quantized vertices
+		{
+			clear();
+			UINT stride = 0;
+
+			for (auto elem : layout)
+			{
+				D3D12_INPUT_ELEMENT_DESC desc;
+				desc.SemanticName = NULL; // setup later
+				desc.SemanticIndex = 0;
+				desc.Format = elem.second;
+				desc.AlignedByteOffset = stride; // in buffer stride
+
+				stride += formatSize(elem.second);
+
+				desc.InputSlot = _inputSlot; // vertex buffer slot
+				desc.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+				desc.InstanceDataStepRate = 0;
+
+				_layout.push_back(desc);
+				_names.push_back(elem.first);
+			}
+
+			_inputSlot++;
+			setupName();
+		}
+
 		void addMat4PerInstanceElement(const eastl::vector<eastl::string>& layout)
 		{
 			for (auto elem : layout)
@@ -108,6 +135,16 @@ namespace dx12
 			_layout.push_back(desc);
 			_names.push_back("MATERIAL");
 
+			// decoding of the quantized vertices, see MeshBuffers
+			desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			desc.AlignedByteOffset = 32;
+			_layout.push_back(desc);
+			_names.push_back("POSITION_DECODE");
+
+			desc.AlignedByteOffset = 48;
+			_layout.push_back(desc);
+			_names.push_back("UV_DECODE");
+
 			setupName();
 		}
 
@@ -127,6 +164,23 @@ namespace dx12
 			_inputSlot = 0;
 		}
 
+		static UINT formatSize(DXGI_FORMAT format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_R8G8_SNORM: case DXGI_FORMAT_R8G8_UNORM:
+				return 2;
+			case DXGI_FORMAT_R16G16_SNORM: case DXGI_FORMAT_R16G16_UNORM: case DXGI_FORMAT_R8G8B8A8_SNORM: case DXGI_FORMAT_R8G8B8A8_UNORM: case DXGI_FORMAT_R32_FLOAT:
+				return 4;
+			case DXGI_FORMAT_R16G16B16A16_SNORM: case DXGI_FORMAT_R16G16B16A16_UNORM: case DXGI_FORMAT_R32G32_FLOAT:
+				return 8;
+			case DXGI_FORMAT_R32G32B32_FLOAT:
+				return 12;
+			default:
+				return 16;
+			}
+		}
+
 		void setupName()
 		{
 			for (size_t i = 0; i < _layout.size(); ++i)
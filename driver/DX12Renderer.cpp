@@ -176,6 +176,8 @@ namespace dx12
 			_matrixBuffersPtr[_bufferIndex][_indexInBuffer + i] = object[i].tranform;
 			_materialBuffersPtr[_bufferIndex][_indexInBuffer + i].textures = object[i].parameter.textures;
 			_materialBuffersPtr[_bufferIndex][_indexInBuffer + i].material = object[i].parameter.parameter;
+			_materialBuffersPtr[_bufferIndex][_indexInBuffer + i].positionDecode = object[i].mesh->positionDecode();
+			_materialBuffersPtr[_bufferIndex][_indexInBuffer + i].uvDecode = object[i].mesh->uvDecode();
 		}
 
 		_commandContext->commandList()->SetPipelineState(material._pipeline->getPipelineState());
@@ -211,7 +213,7 @@ namespace dx12
 			//_commandContext->setConstantBuffer(1, _materialBuffers[_bufferIndex].gpuVirtualAdress() + sizeof(InstanceConstants)*(i + _indexInMaterialBuffer));
 
 			_commandContext->commandList()->DrawIndexedInstanced(mesh->numIndices() >= 0 ? uint32_t(mesh->numIndices()) : mesh->ib()->elemCount(),
-																1, mesh->offset(), 0, 0);
+																1, mesh->offset(), INT(mesh->baseVertex()), 0);
 		}
 
 		_indexInBuffer += object.size();
@@ -78,6 +78,8 @@ namespace dx12
 		{
 			tim::ivec4 textures;
 			tim::vec4 material;
+			tim::vec4 positionDecode;
+			tim::vec4 uvDecode;
 		};
 
 		static constexpr UINT64 MAX_INSTANCE = 1 << 14;
@@ -0,0 +1,164 @@
+#include "CubeSphere.h"
+#include "GridBuilder.h"
+
+namespace tim
+{
+
+namespace
+{
+	struct FaceTransform
+	{
+		mat3 rotation;
+		vec3 translation;
+	};
+
+	/* The grid of a face is centered on the origin in the xy plane, then rotated and translated on its side */
+	const FaceTransform& faceTransform(uint face)
+	{
+		static const FaceTransform transforms[CubeSphere::NB_FACES] =
+		{
+			{ mat3(mat3::RotationY(toRad(90)) * mat3::RotationZ(toRad(0))), vec3(0.5f, 0, 0) },
+			{ mat3(mat3::RotationY(toRad(-90)) * mat3::RotationZ(toRad(180))), vec3(-0.5f, 0, 0) },
+			{ mat3(mat3::RotationX(toRad(-90)) * mat3::RotationZ(toRad(90))), vec3(0, 0.5f, 0) },
+			{ mat3(mat3::RotationX(toRad(90)) * mat3::RotationZ(toRad(-90))), vec3(0, -0.5f, 0) },
+			{ mat3::IDENTITY(), vec3(0, 0, 0.5f) },
+			{ mat3::RotationX(toRad(180)), vec3(0, 0, -0.5f) },
+		};
+		return transforms[face];
+	}
+
+	/* Everitt's mapping, the ratio of the slopes at the center and at the edge of the face */
+	const float EVERITT_EPSILON = 1.4511f;
+
+	/* From a coordinate of the face to the cube, both in [-1,1] */
+	float warp(float u, CubeSphere::Warp w)
+	{
+		switch (w)
+		{
+		case CubeSphere::TANGENT:
+			return tanf(u * PI * 0.25f);
+		case CubeSphere::EVERITT:
+		{
+			const float e = EVERITT_EPSILON;
+			const float x = (e - sqrtf(eastl::max(0.f, e * e - 4 * (e - 1) * fabsf(u)))) / (2 * (e - 1));
+			return u < 0 ? -x : x;
+		}
+		default:
+			return u;
+		}
+	}
+
+	float unwarp(float x, CubeSphere::Warp w)
+	{
+		switch (w)
+		{
+		case CubeSphere::TANGENT:
+			return atanf(x) * 4 / PI;
+		case CubeSphere::EVERITT:
+			return x * (EVERITT_EPSILON + (1 - EVERITT_EPSILON) * fabsf(x));
+		default:
+			return x;
+		}
+	}
+}
+
+vec3 CubeSphere::cubePoint(uint face, vec2 coord, Warp w)
+{
+	vec2 local;
+	for (uint i = 0; i < 2; ++i)
+	{
+		const float inside = eastl::min(1.f, eastl::max(0.f, coord[i]));
+		local[i] = warp(inside * 2 - 1, w) * 0.5f + coord[i] - inside;
+	}
+
+	const FaceTransform& t = faceTransform(face);
+	return t.rotation * vec3(local.x(), local.y(), 0) + t.translation;
+}
+
+vec3 CubeSphere::direction(uint face, vec2 coord, Warp w)
+{
+	return cubePoint(face, coord, w).normalized();
+}
+
+uint CubeSphere::locate(vec3 dir, vec2& coord, Warp w)
+{
+	vec3 a(fabsf(dir.x()), fabsf(dir.y()), fabsf(dir.z()));
+	const uint axis = a.x() >= a.y() && a.x() >= a.z() ? 0 : (a.y() >= a.z() ? 1 : 2);
+	const uint face = axis * 2 + (dir[axis] < 0 ? 1 : 0);
+
+	// back on the cube then in the plane of the face, the rotation is orthonormal
+	const FaceTransform& t = faceTransform(face);
+	vec3 local = t.rotation.transposed() * (dir * (0.5f / a[axis]) - t.translation);
+	for (uint i = 0; i < 2; ++i)
+		coord[i] = unwarp(eastl::min(1.f, eastl::max(-1.f, local[i] * 2)), w) * 0.5f + 0.5f;
+	return face;
+}
+
+void CubeSphere::buildPatch(BaseMesh& mesh, eastl::vector<float>& morphDelta, uint face, vec2 origin, float size, uint resolution, Warp w, const SurfaceFun& surface)
+{
+	morphDelta.clear();
+	if (resolution < 2 || resolution % 2 != 0)
+	{
+		mesh = BaseMesh();
+		return;
+	}
+
+	const uint n = resolution + 1;
+	const float step = size / resolution;
+
+	GridBuilder::Parameter gridParam;
+	gridParam.resolution = { n, n };
+	gridParam.invertFaces = true;
+	gridParam.withUV = false;
+	gridParam.parallel = false;
+	GridBuilder::build(mesh, gridParam);
+
+	// the sample (a,b) is the vertex (a-1,b-1), the first and last rows and columns are outside of the patch
+	const uint ns = n + 2;
+	eastl::vector<vec3> samples(ns * ns);
+	for (uint a = 0; a < ns; ++a)
+	{
+		for (uint b = 0; b < ns; ++b)
+		{
+			vec2 coord(origin.x() + step * (float(a) - 1), origin.y() + step * (float(b) - 1));
+			samples[a * ns + b] = surface(direction(face, coord, w));
+		}
+	}
+
+	auto sample = [&](uint a, uint b) -> const vec3& { return samples[a * ns + b]; };
+
+	mesh._normals.resize(n * n);
+	mesh._texCoords.resize(n * n);
+	morphDelta.resize(n * n);
+
+	for (uint i = 0; i < n; ++i)
+	{
+		for (uint j = 0; j < n; ++j)
+		{
+			const uint a = i + 1, b = j + 1;
+			const uint index = GridBuilder::index({ n, n }, i, j);
+			const vec3 p = sample(a, b);
+
+			// pointing inward as the normals of the grid faces
+			vec3 normal = (sample(a + 1, b) - sample(a - 1, b)).cross(sample(a, b + 1) - sample(a, b - 1)).normalized();
+			if (normal.dot(p) > 0)
+				normal *= -1;
+
+			// the coarser grid skips the odd rows and columns, its quads are split along the same diagonal
+			vec3 target = p;
+			if (i % 2 == 1 && j % 2 == 1)
+				target = (sample(a - 1, b - 1) + sample(a + 1, b + 1)) * 0.5f;
+			else if (i % 2 == 1)
+				target = (sample(a - 1, b) + sample(a + 1, b)) * 0.5f;
+			else if (j % 2 == 1)
+				target = (sample(a, b - 1) + sample(a, b + 1)) * 0.5f;
+
+			mesh._vertices[index] = p;
+			mesh._normals[index] = normal;
+			mesh._texCoords[index] = vec2(origin.x() + step * i, origin.y() + step * j);
+			morphDelta[index] = (target - p).dot(p.normalized());
+		}
+	}
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Mesh.h"
+#include <EASTL/functional.h>
+
+namespace tim
+{
+	/* The sphere as the 6 faces of a cube projected on it, a point of a face has coordinates in [0,1]².
+	   The faces are oriented as the sides of the former planet grid, a GridBuilder grid rotated on each side of the unit cube,
+	   so the coordinates on a face are also its texture coordinates.
+
+	   A patch is a square of a face, origin and size in face coordinates, meshed as a grid of resolution x resolution quads
+	   with the vertex layout and the triangles of GridBuilder (invertFaces). The surface function gives the point of the surface
+	   in a unit direction. The normals are computed from the neighbours of each vertex, a ring of samples around the patch
+	   included, so two adjacent patches of the same size have the same normals on their common border.
+	   The morph delta of a vertex is the distance along its direction from the vertex to the grid of half the resolution,
+	   0 on the vertices shared with that grid: moving every vertex by its delta gives the coarser shape. The resolution must be even.
+
+	   The warp moves the points of a face on the cube before they are projected, the same on both axes. Projected as is,
+	   a cell at the center of a face covers about 5 times the area of a cell in a corner. The tangent warp spaces the points
+	   by the same angle along each axis, Everitt's mapping is a cheaper approximation of equal area with a polynomial inverse,
+	   both bring the ratio between the largest and the smallest cells to about 1.4.
+	   Everything locating or sampling the same sphere must use the same warp. */
+	class CubeSphere
+	{
+	public:
+		enum Face { FACE_X, FACE_NX, FACE_Y, FACE_NY, FACE_Z, FACE_NZ, NB_FACES };
+		enum Warp { GNOMONIC, TANGENT, EVERITT };
+
+		using SurfaceFun = eastl::function<vec3(vec3)>;
+
+		CubeSphere() = delete;
+
+		/* On the cube [-0.5,0.5]^3, warped; the coordinates beyond the face continue on its plane without warp */
+		static vec3 cubePoint(uint face, vec2 coord, Warp);
+		static vec3 direction(uint face, vec2 coord, Warp);
+
+		/* The face the direction goes through and the coordinates on it */
+		static uint locate(vec3 direction, vec2& coord, Warp);
+
+		/* Replace the content of the mesh, with normals and uvs, morphDelta has one value per vertex */
+		static void buildPatch(BaseMesh&, eastl::vector<float>& morphDelta, uint face, vec2 origin, float size, uint resolution, Warp, const SurfaceFun&);
+	};
+}
@@ -34,29 +34,29 @@ namespace tim
         return convertToUVMesh([this](float,float,int index){ return _points[index].w(); }, resolution, mergeLast, triangle, uniform_uv);
     }
 
-    void Curve::tesselateCylindre(BaseMesh& mesh, const eastl::vector<uint>& bottom, const eastl::vector<uint>& top, uint resolution, bool triangulate, bool cut)
+    void Curve::tesselateCylindre(BaseMesh& mesh, uint bottom, uint top, uint resolution, bool triangulate, bool cut)
     {
         const uint res_mod = resolution + (cut ? 1:0);
         for(uint i=0 ; i<resolution ; ++i)
         {
+            const uint i1 = (i+1)%res_mod;
             if(triangulate)
             {
-                mesh.addFace({{bottom[i%res_mod], top[i%res_mod], bottom[(i+1)%res_mod], 0}, 3});
-                mesh.addFace({{top[i%res_mod], top[(i+1)%res_mod], bottom[(i+1)%res_mod], 0}, 3});
+                mesh.addFace({{bottom+i, top+i, bottom+i1, 0}, 3});
+                mesh.addFace({{top+i, top+i1, bottom+i1, 0}, 3});
             }
             else
             {
-                mesh.addFace({{bottom[i%res_mod], top[i%res_mod],
-                           top[(i+1)%res_mod], bottom[(i+1)%res_mod]}, 4});
+                mesh.addFace({{bottom+i, top+i, top+i1, bottom+i1}, 4});
             }
         }
     }
 
-    void Curve::tesselateCone(BaseMesh& mesh, const eastl::vector<uint>& bottom, uint top, uint resolution, bool cut)
+    void Curve::tesselateCone(BaseMesh& mesh, uint bottom, uint top, uint resolution, bool cut)
     {
         const uint res_mod = resolution + (cut ? 1:0);
         for(uint i=0 ; i<resolution ; ++i)
-            mesh.addFace({{bottom[i%res_mod], top, bottom[(i+1)%res_mod], 0}, 3});
+            mesh.addFace({{bottom+i, top, bottom+(i+1)%res_mod, 0}, 3});
     }
 
 	vec3 Curve::computeDirection(uint index) const
@@ -72,47 +72,41 @@ namespace tim
             return (_points[index + 1].to<3>() - _points[index - 1].to<3>()).normalized();
 	}
 
-    void Curve::aligneCircle(const eastl::vector<eastl::pair<vec3,vec2>>& base, eastl::vector<eastl::pair<vec3,vec2>>& top)
+    void Curve::aligneCircle(const eastl::vector<eastl::pair<vec3,vec2>>& base, eastl::vector<eastl::pair<vec3,vec2>>& top,
+                             eastl::vector<eastl::pair<vec3,vec2>>& old)
     {
-        struct detail
-        {
-            // the standard formula to compute the variance of a vec3 array
-            static float variance(const eastl::vector<vec3>& vec)
-            {
-                vec3 mean = 0;
-                for(auto v : vec) mean += v;
-                mean /= (float)vec.size();
-
-                float result = 0;
-                for(auto v:  vec)
-                    result += (v-mean).dot(v-mean);
-                return result / vec.size();
-            }
-        };
-
-        if(base.size() != top.size())
+        if(base.size() != top.size() || base.empty())
             return;
 
-        // compute the variance score for each configuration
-        eastl::vector<float> var_score(base.size());
-        for(int i=0 ; i<int(base.size()) ; ++i)
-        {
-            eastl::vector<vec3> acc;
-            for(int j=0 ; j<int(base.size()) ; ++j)
-               acc.push_back( (base[j].first - top[(i+j)%base.size()].first) );
-            var_score[i] = detail::variance(acc);
-        }
-
-        // select the min variance (such that the edges are aligned)
+        // the variance of the differences for each rotation, E[d.d] - E[d].E[d] without storing the differences
+        const int n = int(base.size());
         int bestIndex=0;
-        for(int i=0 ; i<int(var_score.size()) ; ++i)
+        float bestVariance = std::numeric_limits<float>::max();
+        for(int i=0 ; i<n ; ++i)
         {
-            if(var_score[i] < var_score[bestIndex]) // minimize the variance
+            vec3 mean;
+            float meanLength2 = 0;
+            for(int j=0 ; j<n ; ++j)
+            {
+                vec3 d = base[j].first - top[(i+j)%n].first;
+                mean += d;
+                meanLength2 += d.dot(d);
+            }
+            mean /= float(n);
+
+            float variance = meanLength2 / n - mean.dot(mean);
+            if(variance < bestVariance) // minimize the variance (such that the edges are aligned)
+            {
+                bestVariance = variance;
                 bestIndex = i;
+            }
         }
 
-        // reorder the points to align them
-        eastl::vector<eastl::pair<vec3,vec2>> old(std::move(top));
+        if(bestIndex == 0)
+            return;
+
+        // reorder the points to align them, old keeps its capacity for the next rings
+        old.swap(top);
         top.resize(base.size());
         for(int i=0 ; i<int(base.size()) ; ++i)
         {
@@ -5,6 +5,7 @@
 #include "math/Matrix.h"
 
 #include "geometry/Mesh.h"
+#include "math/UnitCircle.h"
 #include <iostream>
 
 namespace tim
@@ -51,13 +52,14 @@ namespace tim
         bool _closed = false;
 
     private:
-        static void tesselateCylindre(BaseMesh&, const eastl::vector<uint>& bottom, const eastl::vector<uint>& top, uint resolution, bool triangulate, bool cut);
-        static void tesselateCone(BaseMesh&, const eastl::vector<uint>& bottom, uint top, uint resolution, bool cut);
+        /* bottom and top are the first vertex of the rings, a ring has resolution vertices plus one if cut */
+        static void tesselateCylindre(BaseMesh&, uint bottom, uint top, uint resolution, bool triangulate, bool cut);
+        static void tesselateCone(BaseMesh&, uint bottom, uint top, uint resolution, bool cut);
 
-        static void aligneCircle(const eastl::vector<eastl::pair<vec3,vec2>>&, eastl::vector<eastl::pair<vec3,vec2>>&);
+        static void aligneCircle(const eastl::vector<eastl::pair<vec3,vec2>>&, eastl::vector<eastl::pair<vec3,vec2>>&, eastl::vector<eastl::pair<vec3,vec2>>& tmp);
 
         template<class RadiusFun, class TypeMesh>
-        TypeMesh convertToMesh(const RadiusFun&,  uint resolution, bool mergeLast, bool triangle, bool cut, bool uniform_uv=false) const;
+        void appendTube(TypeMesh&, const RadiusFun&,  uint resolution, bool mergeLast, bool triangle, bool cut, bool uniform_uv) const;
 	};
 
     inline void Curve::setClosed(bool b) { _closed = b; }
@@ -86,13 +88,17 @@ namespace tim
     template<class RadiusFun>
     Mesh Curve::convertToMesh(const RadiusFun& fun,  uint resolution, bool mergeLast, bool triangle) const
     {
-        return convertToMesh<RadiusFun, Mesh>(fun, resolution, mergeLast, triangle, false);
+        Mesh mesh;
+        appendTube(mesh, fun, resolution, mergeLast, triangle, false, false);
+        return mesh;
     }
 
     template<class RadiusFun>
     UVMesh Curve::convertToUVMesh(const RadiusFun& fun,  uint resolution, bool mergeLast, bool triangle, bool uniform_uv) const
     {
-        return convertToMesh<RadiusFun, UVMesh>(fun, resolution, mergeLast, triangle, true, uniform_uv);
+        UVMesh mesh;
+        appendTube(mesh, fun, resolution, mergeLast, triangle, true, uniform_uv);
+        return mesh;
     }
 
 	namespace 
@@ -103,88 +109,86 @@ namespace tim
 	}
 
     template<class RadiusFun, class TypeMesh>
-    TypeMesh Curve::convertToMesh(const RadiusFun& fun,  uint resolution, bool mergeLast, bool triangle, bool cut, bool uniform_uv) const
+    void Curve::appendTube(TypeMesh& mesh, const RadiusFun& fun,  uint resolution, bool mergeLast, bool triangle, bool cut, bool uniform_uv) const
     {
 		if (_closed)
 			mergeLast = false;
 
-		TypeMesh mesh;
-
 		if (resolution < 3 || _points.size() <= 2)
-			return mesh;
+			return;
+
+        const uint nbPoints = uint(_points.size());
+        const uint ringSize = resolution + (cut ? 1:0);
+        const uint nbRings = mergeLast ? nbPoints - 1 : nbPoints;
+        const uint nbCylinders = _closed ? nbRings : nbRings - 1;
+        const uint firstIndex = mesh.nbVertices();
 
-        float timeStep = 1.f / (_points.size()-1);
-        eastl::vector<eastl::vector<uint>> pointIndexes(_points.size(), eastl::vector<uint>(resolution+(cut ? 1:0)));
-		uint curIndex = 0;
+        // the ring i starts at the vertex firstIndex + i*ringSize, the tip is after the last ring
+        mesh._vertices.reserve(mesh._vertices.size() + nbRings * ringSize + (mergeLast ? 1:0));
+        if (cut)
+            mesh._texCoords.reserve(mesh._texCoords.size() + nbRings * ringSize + (mergeLast ? 1:0));
+        mesh._faces.reserve(mesh._faces.size() + nbCylinders * resolution * (triangle ? 2:1) + (mergeLast ? resolution : 0));
 
-        eastl::vector<eastl::pair<vec3,vec2>> prevPts;
+        const vec2* unitCircle = UnitCircle::table(resolution);
+        const float timeStep = 1.f / (nbPoints-1);
+
+        // the rings are reused along the curve
+        eastl::vector<eastl::pair<vec3,vec2>> prevPts, newPts, aligned;
         float accSizeCurve = 0;
 
-		for (size_t i = 0; i<_points.size() + 1; ++i)
+		for (uint i = 0; i<nbPoints + 1; ++i)
 		{
-			if (i == _points.size() && !_closed)
+			if (i == nbPoints && !_closed)
 				break;
 
 			vec3 dir;
 			if (_closed)
-                dir = (_points[(i + 1) % _points.size()].to<3>() - _points[pmod(static_cast<int>(i) - 1, (int)_points.size())].to<3>());
+                dir = (_points[(i + 1) % nbPoints].to<3>() - _points[pmod(static_cast<int>(i) - 1, (int)nbPoints)].to<3>());
 			else
-                dir = (_points[std::min(i + 1, _points.size() - 1)].to<3>() - _points[i == 0 ? 0 : i - 1].to<3>());
+                dir = (_points[std::min(i + 1, nbPoints - 1)].to<3>() - _points[i == 0 ? 0 : i - 1].to<3>());
 
             float sizeStep = dir.length();
             accSizeCurve += sizeStep;
             dir /= sizeStep;
 
 			mat3 base = mat3::changeBasis(dir);
+            const uint ringIndex = firstIndex + i * ringSize;
 
-			if (!mergeLast || i < _points.size() - 1)
+			if (!mergeLast || i < nbPoints - 1)
 			{
-				if (i < _points.size())
+				if (i < nbPoints)
 				{
-                    eastl::vector<eastl::pair<vec3,vec2>> newPts;
-                    float accAroundCurve=0;
-                    for (uint j = 0; j < resolution+(cut ? 1:0); ++j)
+                    newPts.resize(resolution);
+                    for (uint j = 0; j < resolution; ++j)
 					{
-                        if(j < resolution)
-                        {
-                            const float theta_norm = static_cast<float>(j) / resolution;
-                            const float theta = theta_norm * 2 * PI;
-
-                            vec3 p = _points[i].to<3>() + base * (vec3(cosf(theta), sinf(theta), 0.f) * fun(timeStep * i, theta_norm, i));
-                            vec2 uv = uniform_uv ? vec2(theta_norm, timeStep * i) : vec2(TAU*_points[i].w() * theta_norm, accSizeCurve);
+                        const float theta_norm = static_cast<float>(j) / resolution;
 
-                            newPts.push_back({p,uv});
-                            accAroundCurve += _points[i].w();
-                        }
-
-						pointIndexes[i][j] = curIndex + j;
+                        vec3 p = _points[i].to<3>() + base * (vec3(unitCircle[j].x(), unitCircle[j].y(), 0.f) * fun(timeStep * i, theta_norm, i));
+                        vec2 uv = uniform_uv ? vec2(theta_norm, timeStep * i) : vec2(TAU*_points[i].w() * theta_norm, accSizeCurve);
+                        newPts[j] = {p,uv};
 					}
 
-                    aligneCircle(prevPts, newPts);
+                    aligneCircle(prevPts, newPts, aligned);
 
-                    for(auto p : newPts)
+                    for(const auto& p : newPts)
                         AddVertex<TypeMesh>::add(mesh, p.first, p.second);
 
                     if(cut)
                         AddVertex<TypeMesh>::add(mesh, newPts[0].first, {TAU*_points[i].w(), newPts[0].second.y()});
 
-                    prevPts = newPts;
+                    eastl::swap(prevPts, newPts);
                 }
 
 				if (i > 0)
-                    tesselateCylindre(mesh, pointIndexes[pmod(static_cast<int>(i) - 1, (int)_points.size())], pointIndexes[i%_points.size()], resolution, triangle, cut);
+                    tesselateCylindre(mesh, firstIndex + (i - 1) * ringSize, firstIndex + (i % nbPoints) * ringSize, resolution, triangle, cut);
 			}
 			else // we need to create a unique point closing the mesh
 			{
-                vec3 p = _points[i%_points.size()].to<3>() + base * (vec3::construct(0) * fun(timeStep * i, 0, i));
+                vec3 p = _points[i%nbPoints].to<3>() + base * (vec3::construct(0) * fun(timeStep * i, 0, i));
                 vec2 uv = vec2(0, accSizeCurve /** timeStep * i*/);
 				AddVertex<TypeMesh>::add(mesh, p, uv);
-                tesselateCone(mesh, pointIndexes[i - 1], curIndex, resolution, cut);
+                tesselateCone(mesh, ringIndex - ringSize, ringIndex, resolution, cut);
 			}
-
-            curIndex += (resolution + (cut ? 1:0));
 		}
-
-		return mesh;
     }
 }
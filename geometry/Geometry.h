@@ -15,14 +15,14 @@ struct Geometry
 		//plan.invertFaces();
         MeshType result;
 
-        result += plan.translated(vec3(0,0,0.5));
-        result += plan.translated(vec3(0,0,0.5)).scaled(vec3(1,1,-1)).invertFaces();
+        plan.deferred().translated(vec3(0,0,0.5)).appendTo(result);
+        result += plan.deferred().translated(vec3(0,0,0.5)).scaled(vec3(1,1,-1)).apply().invertFaces();
 
-        result += plan.rotated(mat3::RotationX(toRad(-90))).translated(vec3(0,0.5,0));
-        result += plan.rotated(mat3::RotationX(toRad(90))).translated(vec3(0,-0.5,0));
+        plan.deferred().rotated(mat3::RotationX(toRad(-90))).translated(vec3(0,0.5,0)).appendTo(result);
+        plan.deferred().rotated(mat3::RotationX(toRad(90))).translated(vec3(0,-0.5,0)).appendTo(result);
 
-        result += plan.rotated(mat3::RotationY(toRad(90))).translated(vec3(0.5,0,0));
-        result += plan.rotated(mat3::RotationY(toRad(-90))).translated(vec3(-0.5,0,0));
+        plan.deferred().rotated(mat3::RotationY(toRad(90))).translated(vec3(0.5,0,0)).appendTo(result);
+        plan.deferred().rotated(mat3::RotationY(toRad(-90))).translated(vec3(-0.5,0,0)).appendTo(result);
 
         return result.mapVertices([=](vec3 v) { return v.normalized()*radius; });
     }
@@ -0,0 +1,150 @@
+#include "GridBuilder.h"
+#include "Parallel.h"
+
+namespace tim
+{
+
+namespace
+{
+	const uint ROWS_PER_TASK = 32;
+	const uint PARALLEL_THRESHOLD = 1 << 16; // vertices
+
+	/* The 2 samples and the smooth weight along an axis of the heightmap, see ImageAlgorithm::getSmooth */
+	struct Sample
+	{
+		uint first, second;
+		float weight;
+	};
+
+	Sample computeSample(float x, uint size)
+	{
+		int ix = int(x);
+		Sample s;
+		s.first = uint(eastl::max(eastl::min(ix, int(size) - 1), 0));
+		s.second = uint(eastl::max(eastl::min(ix + 1, int(size) - 1), 0));
+		s.weight = (1.f - cosf((x - floorf(x)) * PI)) * 0.5f;
+		return s;
+	}
+}
+
+uint GridBuilder::nbVertices(const Parameter& param)
+{
+	if (param.resolution.x() <= 1 || param.resolution.y() <= 1)
+		return 0;
+	return param.resolution.x() * param.resolution.y();
+}
+
+uint GridBuilder::nbFaces(const Parameter& param)
+{
+	if (param.resolution.x() <= 1 || param.resolution.y() <= 1)
+		return 0;
+	return (param.resolution.x() - 1) * (param.resolution.y() - 1) * (param.triangulate ? 2 : 1);
+}
+
+void GridBuilder::build(BaseMesh& mesh, const Parameter& param)
+{
+	mesh = BaseMesh();
+
+	const uint nbV = nbVertices(param);
+	if (nbV == 0)
+		return;
+
+	const uivec2 res = param.resolution;
+	const vec2 d = { param.size.x() / (res.x() - 1), param.size.y() / (res.y() - 1) };
+	const vec2 halfSize = param.size * 0.5f;
+	const uint facesPerQuad = param.triangulate ? 2 : 1;
+
+	mesh._vertices.resize(nbV);
+	mesh._faces.resize(nbFaces(param));
+	if (param.withUV)
+		mesh._texCoords.resize(nbV);
+
+	const bool withHeight = param.heightmap && !param.heightmap->empty();
+	const float* heightData = withHeight ? param.heightmap->data() : nullptr;
+	const uivec2 heightSize = withHeight ? param.heightmap->size() : uivec2();
+
+	// the sample positions on the columns are the same for every row
+	eastl::vector<Sample> columnSamples;
+	vec2 dImg;
+	if (withHeight)
+	{
+		dImg = vec2(float(heightSize.x()) / (res.x() - 1), float(heightSize.y()) / (res.y() - 1));
+		columnSamples.resize(res.y());
+		for (uint j = 0; j < res.y(); ++j)
+			columnSamples[j] = computeSample(dImg.y() * j, heightSize.y());
+	}
+
+	// faces of the quad (i-1,j-1) (i,j), the winding of the triangles matches the previous generateGrid
+	auto writeFaces = [&](uint i, uint j)
+	{
+		uint a = index(res, i - 1, j - 1), b = index(res, i, j - 1), c = index(res, i, j), e = index(res, i - 1, j);
+		BaseMesh::Face* f = mesh._faces.data() + size_t((i - 1) * (res.y() - 1) + j - 1) * facesPerQuad;
+
+		if (param.triangulate)
+		{
+			f[0] = { { a, b, c, 0 }, 3 };
+			f[1] = { { c, e, a, 0 }, 3 };
+			if (param.invertFaces)
+			{
+				eastl::swap(f[0].indexes[0], f[0].indexes[1]);
+				eastl::swap(f[1].indexes[0], f[1].indexes[1]);
+			}
+		}
+		else
+			f[0] = param.invertFaces ? BaseMesh::Face{ { b, a, e, c }, 4 } : BaseMesh::Face{ { a, b, c, e }, 4 };
+	};
+
+	auto buildRows = [&](uint band)
+	{
+		const uint firstRow = band * ROWS_PER_TASK;
+		const uint lastRow = eastl::min(firstRow + ROWS_PER_TASK, res.x());
+
+		for (uint i = firstRow; i < lastRow; ++i)
+		{
+			vec3* vertices = mesh._vertices.data() + size_t(i) * res.y();
+			const float x = d.x() * i - halfSize.x();
+
+			for (uint j = 0; j < res.y(); ++j)
+				vertices[j] = vec3(x, d.y() * j - halfSize.y(), 0);
+
+			if (withHeight)
+			{
+				Sample row = computeSample(dImg.x() * i, heightSize.x());
+				const float* r0 = heightData + size_t(row.first) * heightSize.y();
+				const float* r1 = heightData + size_t(row.second) * heightSize.y();
+
+				for (uint j = 0; j < res.y(); ++j)
+				{
+					const Sample& col = columnSamples[j];
+					float h0 = interpolate(r0[col.first], r1[col.first], row.weight);
+					float h1 = interpolate(r0[col.second], r1[col.second], row.weight);
+					vertices[j].z() = interpolate(h0, h1, col.weight) * param.zScale;
+				}
+			}
+
+			if (param.withUV)
+			{
+				vec2* uvs = mesh._texCoords.data() + size_t(i) * res.y();
+				for (uint j = 0; j < res.y(); ++j)
+					uvs[j] = vec2(float(i) / (res.x() - 1), float(j) / (res.y() - 1));
+			}
+
+			if (i > 0)
+			{
+				for (uint j = 1; j < res.y(); ++j)
+					writeFaces(i, j);
+			}
+		}
+	};
+
+	const uint nbBands = (res.x() + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	if (param.parallel && nbV >= PARALLEL_THRESHOLD)
+		parallelFor(nbBands, buildRows);
+	else
+	{
+		for (uint band = 0; band < nbBands; ++band)
+			buildRows(band);
+	}
+}
+
+}
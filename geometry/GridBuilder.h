@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Mesh.h"
+
+namespace tim
+{
+	/* Regular grid centered on the origin in the xy plane, the vertex (i,j) has the index i*resolution.y()+j.
+	   The output sizes are known in advance, vertices, uvs and faces are written in place in preallocated buffers.
+	   The heightmap is sampled with the weights of each row and column computed once, as getSmooth would do.
+	   Large grids are split in bands of rows generated in parallel. */
+	class GridBuilder
+	{
+	public:
+		struct Parameter
+		{
+			vec2 size = { 1, 1 };
+			uivec2 resolution; // number of vertices on each axis
+			const ImageAlgorithm<float>* heightmap = nullptr;
+			float zScale = 0;
+			bool withUV = true;
+			bool triangulate = true;
+			bool invertFaces = false;
+			bool parallel = true;
+		};
+
+		GridBuilder() = delete;
+
+		static uint nbVertices(const Parameter&);
+		static uint nbFaces(const Parameter&);
+
+		static uint index(uivec2 resolution, uint i, uint j) { return i * resolution.y() + j; }
+
+		/* Replace the content of the mesh */
+		static void build(BaseMesh&, const Parameter&);
+	};
+}
@@ -0,0 +1,216 @@
+#include "HalfEdgeMesh.h"
+
+namespace tim
+{
+
+const uint HalfEdgeMesh::INVALID;
+
+HalfEdgeMesh::HalfEdgeMesh(const BaseMesh& mesh)
+{
+	const uint nbV = mesh.nbVertices();
+
+	uint nbHe = 0;
+	for (const auto& f : mesh._faces)
+		nbHe += (f.nbIndexes == 3 || f.nbIndexes == 4) ? f.nbIndexes : 0;
+
+	_origin.resize(nbHe);
+	_face.resize(nbHe);
+	_twin.resize(nbHe, INVALID);
+	_faceFirst.clear();
+	_faceFirst.reserve(mesh._faces.size() + 1);
+	_faceFirst.push_back(0);
+
+	uint he = 0;
+	for (const auto& f : mesh._faces)
+	{
+		if (f.nbIndexes != 3 && f.nbIndexes != 4)
+			continue;
+
+		const uint faceIndex = uint(_faceFirst.size()) - 1;
+		for (int k = 0; k < f.nbIndexes; ++k, ++he)
+		{
+			_origin[he] = f.indexes[k];
+			_face[he] = faceIndex;
+		}
+		_faceFirst.push_back(he);
+	}
+
+	// half-edges bucketed by the lowest vertex of their edge, a counting sort
+	eastl::vector<uint> bucketFirst(nbV + 1, 0);
+	eastl::vector<uint> sorted(nbHe);
+	eastl::vector<uint> other(nbHe);
+
+	for (uint h = 0; h < nbHe; ++h)
+	{
+		uint a = _origin[h], b = target(h);
+		other[h] = eastl::max(a, b);
+		++bucketFirst[eastl::min(a, b) + 1];
+	}
+	for (uint v = 0; v < nbV; ++v)
+		bucketFirst[v + 1] += bucketFirst[v];
+
+	{
+		eastl::vector<uint> fill(bucketFirst.begin(), bucketFirst.end() - 1);
+		for (uint h = 0; h < nbHe; ++h)
+			sorted[fill[eastl::min(_origin[h], target(h))]++] = h;
+	}
+
+	// the buckets are as small as the valence, the matching inside is quadratic
+	for (uint v = 0; v < nbV; ++v)
+	{
+		for (uint i = bucketFirst[v]; i < bucketFirst[v + 1]; ++i)
+		{
+			const uint h = sorted[i];
+			if (_twin[h] != INVALID || other[h] == INVALID)
+				continue;
+
+			uint nbSame = 1, opposite = INVALID;
+			for (uint j = i + 1; j < bucketFirst[v + 1]; ++j)
+			{
+				const uint h2 = sorted[j];
+				if (other[h2] != other[h])
+					continue;
+
+				++nbSame;
+				if (_origin[h2] != _origin[h])
+					opposite = h2;
+			}
+
+			if (nbSame == 2 && opposite != INVALID)
+			{
+				_twin[h] = opposite;
+				_twin[opposite] = h;
+			}
+			else if (nbSame > 1)
+			{
+				// every half-edge of a non manifold edge stays a boundary
+				++_nbNonManifoldEdges;
+				for (uint j = i; j < bucketFirst[v + 1]; ++j)
+				{
+					if (other[sorted[j]] == other[h] && sorted[j] != h)
+						other[sorted[j]] = INVALID;
+				}
+			}
+		}
+	}
+
+	// a boundary half-edge first so the one-rings start on the boundary
+	_vertexHalfEdge.resize(nbV, INVALID);
+	for (uint h = 0; h < nbHe; ++h)
+	{
+		uint& vh = _vertexHalfEdge[_origin[h]];
+		if (vh == INVALID || (_twin[h] == INVALID && _twin[vh] != INVALID))
+			vh = h;
+	}
+}
+
+uint HalfEdgeMesh::nextBoundary(uint he) const
+{
+	uint h = next(he);
+	while (_twin[h] != INVALID)
+		h = next(_twin[h]);
+	return h;
+}
+
+HalfEdgeMesh::Boundaries HalfEdgeMesh::boundaries() const
+{
+	Boundaries result;
+	result.loopFirst.push_back(0);
+
+	eastl::vector<bool> visited(nbHalfEdges(), false);
+	for (uint h = 0; h < nbHalfEdges(); ++h)
+	{
+		if (_twin[h] != INVALID || visited[h])
+			continue;
+
+		// the size bound stops the walk on the non manifold vertices, where the loops can cross
+		uint current = h;
+		for (uint n = 0; n < nbHalfEdges() && !visited[current]; ++n)
+		{
+			visited[current] = true;
+			result.halfEdges.push_back(current);
+			current = nextBoundary(current);
+		}
+		result.loopFirst.push_back(uint(result.halfEdges.size()));
+	}
+
+	return result;
+}
+
+bool HalfEdgeMesh::canFlip(uint he) const
+{
+	const uint t = _twin[he];
+	if (t == INVALID || faceSize(_face[he]) != 3 || faceSize(_face[t]) != 3)
+		return false;
+
+	const uint c = _origin[prev(he)], d = _origin[prev(t)];
+	if (c == d)
+		return false;
+
+	// the new edge must not exist already, on a boundary the incoming edge of the last face closes the ring
+	for (uint h : oneRing(c))
+	{
+		if (target(h) == d || _origin[prev(h)] == d)
+			return false;
+	}
+
+	return true;
+}
+
+bool HalfEdgeMesh::flip(uint he)
+{
+	if (!canFlip(he))
+		return false;
+
+	// the triangles (a,b,c) and (b,a,d) become (c,d,b) and (d,c,a), each in its own half-edge slots
+	const uint h0 = he, h1 = next(h0), h2 = next(h1);
+	const uint t0 = _twin[he], t1 = next(t0), t2 = next(t1);
+
+	const uint a = _origin[h0], b = _origin[h1], c = _origin[h2], d = _origin[t2];
+	const uint twinH1 = _twin[h1], twinH2 = _twin[h2], twinT1 = _twin[t1], twinT2 = _twin[t2];
+
+	_origin[h0] = c; _origin[h1] = d; _origin[h2] = b;
+	_origin[t0] = d; _origin[t1] = c; _origin[t2] = a;
+
+	auto link = [&](uint x, uint y)
+	{
+		_twin[x] = y;
+		if (y != INVALID)
+			_twin[y] = x;
+	};
+
+	link(h0, t0);
+	link(h1, twinT2);
+	link(h2, twinH1);
+	link(t1, twinH2);
+	link(t2, twinT1);
+
+	// the edges kept their half-edge but moved to another slot
+	for (uint v : { a, b, c, d })
+	{
+		uint& vh = _vertexHalfEdge[v];
+		if (vh == h1) vh = h2;
+		else if (vh == h2) vh = t1;
+		else if (vh == t1) vh = t2;
+		else if (vh == t2) vh = h1;
+		else if (vh == h0) vh = t2;
+		else if (vh == t0) vh = h2;
+	}
+
+	return true;
+}
+
+void HalfEdgeMesh::writeFaces(BaseMesh& mesh) const
+{
+	mesh._faces.resize(nbFaces());
+	for (uint f = 0; f < nbFaces(); ++f)
+	{
+		BaseMesh::Face& face = mesh._faces[f];
+		face.nbIndexes = int(faceSize(f));
+		face.indexes = { 0,0,0,0 };
+		for (uint k = 0; k < faceSize(f); ++k)
+			face.indexes[k] = _origin[_faceFirst[f] + k];
+	}
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Mesh.h"
+
+namespace tim
+{
+	/* Index based half-edge connectivity of the triangles and quads of a BaseMesh, lines and points are ignored.
+	   The half-edges of a face are contiguous, the half-edge k of the face f is faceHalfEdge(f)+k and goes from its k-th vertex to the next one.
+	   Everything is stored in flat arrays, the twins are paired with a counting sort on the lowest vertex of the edges, no hashing.
+	   An edge shared by more than 2 faces, or twice in the same direction, is non manifold: its half-edges stay without twin.
+	   The vertices are the ones of the mesh, two vertices with the same position but different indices are not connected. */
+	class HalfEdgeMesh
+	{
+	public:
+		static const uint INVALID = uint(-1);
+
+		HalfEdgeMesh() = default;
+		explicit HalfEdgeMesh(const BaseMesh&);
+
+		uint nbVertices() const { return uint(_vertexHalfEdge.size()); }
+		uint nbFaces() const { return uint(_faceFirst.size()) - 1; }
+		uint nbHalfEdges() const { return uint(_origin.size()); }
+		uint nbNonManifoldEdges() const { return _nbNonManifoldEdges; }
+
+		uint origin(uint he) const { return _origin[he]; }
+		uint target(uint he) const { return _origin[next(he)]; }
+		uint twin(uint he) const { return _twin[he]; }
+		uint face(uint he) const { return _face[he]; }
+		uint next(uint he) const { return he + 1 == _faceFirst[_face[he] + 1] ? _faceFirst[_face[he]] : he + 1; }
+		uint prev(uint he) const { return he == _faceFirst[_face[he]] ? _faceFirst[_face[he] + 1] - 1 : he - 1; }
+
+		uint faceHalfEdge(uint f) const { return _faceFirst[f]; }
+		uint faceSize(uint f) const { return _faceFirst[f + 1] - _faceFirst[f]; }
+
+		/* An outgoing half-edge, the boundary one if the vertex is on a boundary. INVALID for the isolated vertices */
+		uint vertexHalfEdge(uint v) const { return _vertexHalfEdge[v]; }
+
+		bool isBoundary(uint he) const { return _twin[he] == INVALID; }
+		bool isBoundaryVertex(uint v) const { return _vertexHalfEdge[v] != INVALID && isBoundary(_vertexHalfEdge[v]); }
+
+		/* The outgoing half-edges around a vertex, turning from vertexHalfEdge(v) until a boundary or a full turn.
+		   On a non manifold vertex only the fan of vertexHalfEdge(v) is visited */
+		class OneRing
+		{
+		public:
+			class iterator
+			{
+			public:
+				iterator(const HalfEdgeMesh* mesh, uint start, uint he) : _mesh(mesh), _start(start), _he(he) {}
+
+				uint operator*() const { return _he; }
+				bool operator!=(const iterator& it) const { return _he != it._he; }
+				iterator& operator++()
+				{
+					_he = _mesh->_twin[_mesh->prev(_he)];
+					if (_he == _start)
+						_he = INVALID;
+					return *this;
+				}
+
+			private:
+				const HalfEdgeMesh* _mesh;
+				uint _start, _he;
+			};
+
+			OneRing(const HalfEdgeMesh* mesh, uint start) : _mesh(mesh), _start(start) {}
+			iterator begin() const { return iterator(_mesh, _start, _start); }
+			iterator end() const { return iterator(_mesh, _start, INVALID); }
+
+		private:
+			const HalfEdgeMesh* _mesh;
+			uint _start;
+		};
+
+		OneRing oneRing(uint v) const { return OneRing(this, _vertexHalfEdge[v]); }
+
+		/* The boundary half-edge following a boundary half-edge, around the hole */
+		uint nextBoundary(uint he) const;
+
+		/* The boundary loops, the half-edges of the loop i are halfEdges[loopFirst[i]] to halfEdges[loopFirst[i+1]-1] */
+		struct Boundaries
+		{
+			eastl::vector<uint> halfEdges;
+			eastl::vector<uint> loopFirst;
+
+			uint nbLoops() const { return loopFirst.empty() ? 0 : uint(loopFirst.size()) - 1; }
+		};
+		Boundaries boundaries() const;
+
+		/* Replace the edge of two triangles by the other diagonal of the quad they make.
+		   Fails on a boundary, a quad or when the other diagonal is already an edge */
+		bool canFlip(uint he) const;
+		bool flip(uint he);
+
+		/* Replace the faces of the mesh, its vertices are kept */
+		void writeFaces(BaseMesh&) const;
+
+	private:
+		eastl::vector<uint> _origin;
+		eastl::vector<uint> _twin;
+		eastl::vector<uint> _face;
+		eastl::vector<uint> _faceFirst = { 0 };
+		eastl::vector<uint> _vertexHalfEdge;
+		uint _nbNonManifoldEdges = 0;
+	};
+}
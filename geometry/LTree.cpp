@@ -1,10 +1,28 @@
 
 #include "LTree.h"
+#include "Parallel.h"
+#include <EASTL/algorithm.h>
 
 namespace tim
 {
 
-LTree::LTree(Parameter parameter, int seed) : _randEngine(seed), _random(0,1)
+const uint LTree::NO_NODE;
+
+namespace
+{
+    const uint BRANCHES_PER_TASK = 4;
+
+    /* Seed of the index-th branch started by the branch of the given seed, splitmix64 finalizer */
+    uint branchSeed(uint seed, uint index)
+    {
+        uint64_t x = ((uint64_t(seed) << 32) | index) + 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return uint(x ^ (x >> 31));
+    }
+}
+
+LTree::LTree(Parameter parameter, int seed, GrowthMode mode) : _randEngine(seed), _random(0,1)
 {
     float acc=0;
     for(auto x : parameter.branchSplitDensity)
@@ -20,59 +38,245 @@ LTree::LTree(Parameter parameter, int seed) : _randEngine(seed), _random(0,1)
     GenParam detail;
     detail.branchSize = 0; // initially the trunk is generated
     detail.thickness = parameter.meshing.trunkThickness;
-    _root = generateBranchRec(parameter, nullptr, vec3(0,0,0), vec3(0,0,1), detail);
+    if(mode == PARALLEL)
+        growParallel(parameter, detail, seed);
+    else
+        generateBranchRec(parameter, NO_NODE, vec3(0,0,0), vec3(0,0,1), detail);
+}
+
+LTree::LTree(uint seed) : _randEngine(seed), _random(0,1), _deferBranches(true), _branchSeed(seed)
+{
 }
 
-Mesh LTree::generateMesh(int resolution) const
+void LTree::growParallel(const Parameter& param, const GenParam& detail, int seed)
 {
+    // level by level: the branches started by a level are grown by the next one, the subtrees are merged in order
+    eastl::vector<PendingBranch> level = { { NO_NODE, vec3(0,0,0), vec3(0,0,1), detail, branchSeed(uint(seed), 0) } };
+    while(!level.empty())
+    {
+        eastl::vector<LTree> subtrees;
+        subtrees.reserve(level.size());
+        for(const PendingBranch& branch : level)
+            subtrees.push_back(LTree(branch.seed));
+
+        parallelFor(uint(level.size()), [&](uint i)
+        {
+            const PendingBranch& branch = level[i];
+            subtrees[i].generateBranchRec(param, NO_NODE, branch.position, branch.direction, branch.detail);
+        }, BRANCHES_PER_TASK);
+
+        eastl::vector<PendingBranch> next;
+        for(uint i=0 ; i<uint(level.size()) ; ++i)
+        {
+            const uint first = append(subtrees[i], level[i].parent);
+            for(PendingBranch branch : subtrees[i]._pendingBranches)
+            {
+                branch.parent += first;
+                next.push_back(branch);
+            }
+        }
+        level.swap(next);
+    }
+}
+
+uint LTree::append(const LTree& tree, uint parent)
+{
+    const uint first = _nodes.size();
+    const uint firstCurve = uint(_curves.size());
+    const uint firstPoint = uint(_points.size());
+    auto offset = [](uint index, uint first) { return index == NO_NODE ? NO_NODE : index + first; };
+
+    _points.insert(_points.end(), tree._points.begin(), tree._points.end());
+    _radius.insert(_radius.end(), tree._radius.begin(), tree._radius.end());
+    for(uivec2 curve : tree._curves)
+        _curves.push_back(uivec2(curve.x() + firstPoint, curve.y()));
+
+    for(uint n=0 ; n<tree._nodes.size() ; ++n)
+    {
+        _nodes.parent.push_back(n == 0 ? parent : offset(tree._nodes.parent[n], first));
+        _nodes.firstChild.push_back(offset(tree._nodes.firstChild[n], first));
+        _nodes.nextSibling.push_back(offset(tree._nodes.nextSibling[n], first));
+        _nodes.curve.push_back(tree._nodes.curve[n] + firstCurve);
+        _nodes.range.push_back(tree._nodes.range[n]);
+    }
+
+    if(parent != NO_NODE && tree._nodes.size() > 0)
+        linkChild(parent, first);
+    return first;
+}
+
+Mesh LTree::generateMesh(int resolution, float maxError) const
+{
+    TubeMesher::Parameter param;
+    param.resolution = uint(resolution);
+    param.withUV = false;
+    param.maxError = maxError;
+
+    eastl::vector<Curve> curves;
+    TubeMesher mesher(param);
+    addTubes(curves, mesher);
+
     Mesh mesh;
-    generateMeshRec(_root, mesh, resolution, 0);
+    mesher.build(mesh);
     return mesh;
 }
 
-UVMesh LTree::generateUVMesh(int resolution) const
+UVMesh LTree::generateUVMesh(int resolution, float maxError) const
 {
+    TubeMesher::Parameter param;
+    param.resolution = uint(resolution);
+    param.maxError = maxError;
+
+    eastl::vector<Curve> curves;
+    TubeMesher mesher(param);
+    addTubes(curves, mesher);
+
     UVMesh mesh;
-    generateUVMeshRec(_root, mesh, resolution, 0);
+    mesher.build(mesh);
     return mesh;
 }
 
 Mesh LTree::generateLeaf(const LeafParameter& leaf) const
 {
     Mesh m;
-    generateLeafRec(leaf, _root, m);
+    if(_nodes.size() == 0)
+        return m;
+
+    // chain[n] is the number of continuations after the node, the leaves go on the last ones of each curve
+    eastl::vector<uint> chain(_nodes.size(), 0);
+    for(uint n = _nodes.size() ; n-- > 0 ;)
+    {
+        uint child = continuation(n);
+        if(child != NO_NODE)
+            chain[n] = chain[child] + 1;
+    }
+
+    // post order, the children before their parent, the branches of a node without continuation are not visited
+    eastl::vector<eastl::pair<uint,bool>> stack;
+    stack.push_back({0, false});
+    while(!stack.empty())
+    {
+        const uint node = stack.back().first;
+        const bool expanded = stack.back().second;
+        stack.pop_back();
+
+        const uint child = continuation(node);
+        if(child != NO_NODE && !expanded)
+        {
+            stack.push_back({node, true});
+            const size_t first = stack.size();
+            for(uint c = child ; c != NO_NODE ; c = _nodes.nextSibling[c])
+                stack.push_back({c, false});
+            eastl::reverse(stack.begin() + first, stack.end());
+        }
+        else if(child == NO_NODE || chain[child] <= leaf.depth)
+            generateNodeLeaves(leaf, node, m);
+    }
     return m;
 }
 
 void LTree::exportOBJ(eastl::string filename) const
 {
     Mesh acc;
-    accumulateMesh(acc, _root, 0);
+    for(uint c = 0 ; c < uint(_curves.size()) ; ++c)
+        acc += makeCurve(c).convertToWireMesh();
 
     acc.exportToObj(filename);
 }
 
-LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3 position, vec3 direction, GenParam detailParam)
+uint LTree::addNode(uint parent, uint curve)
+{
+    const uint node = _nodes.size();
+    _nodes.parent.push_back(parent);
+    _nodes.firstChild.push_back(NO_NODE);
+    _nodes.nextSibling.push_back(NO_NODE);
+    _nodes.curve.push_back(curve);
+    _nodes.range.push_back(uivec2());
+
+    if(parent != NO_NODE)
+        linkChild(parent, node);
+    return node;
+}
+
+void LTree::linkChild(uint parent, uint node)
+{
+    uint* link = &_nodes.firstChild[parent];
+    while(*link != NO_NODE)
+        link = &_nodes.nextSibling[*link];
+    *link = node;
+}
+
+uint LTree::continuation(uint node) const
+{
+    const uint child = _nodes.firstChild[node];
+    return child != NO_NODE && _nodes.curve[child] == _nodes.curve[node] ? child : NO_NODE;
+}
+
+void LTree::addPoint(uint curve, vec3 p, float radius)
+{
+    // only the last curve grows: a node generates its continuation before any new branch
+    _points.push_back(p);
+    _radius.push_back(radius);
+    _curves[curve].y()++;
+}
+
+vec3 LTree::curvePoint(uint curve, uint index) const
+{
+    return _points[_curves[curve].x() + index];
+}
+
+float LTree::curveRadius(uint curve, uint index) const
+{
+    return _radius[_curves[curve].x() + index];
+}
+
+vec3 LTree::curveDirection(uint curve, uint index) const
+{
+    // as Curve::computeDirection
+    const uint size = _curves[curve].y();
+    if(size <= 1 || index >= size)
+        return vec3();
+
+    const vec3* p = _points.data() + _curves[curve].x();
+    if(index == 0)
+        return (p[1] - p[0]).normalized();
+    else if(index == size-1)
+        return (p[index] - p[index-1]).normalized();
+    else
+        return (p[index+1] - p[index-1]).normalized();
+}
+
+Curve LTree::makeCurve(uint curve) const
+{
+    Curve c;
+    for(uint i=0 ; i<_curves[curve].y() ; ++i)
+        c.addPoint(curvePoint(curve, i), curveRadius(curve, i));
+    return c;
+}
+
+uint LTree::generateBranchRec(const Parameter& param, uint parent, vec3 position, vec3 direction, GenParam detailParam)
 {
-    Node* node = &_nodePool.push_back();
-    node->parent = parent;
     bool isTrunk = detailParam.isTrunk;
 
     // initialize node
+    uint curve;
+    uivec2 range;
     if(detailParam.needNewCurve)
     {
-        node->curve = &_curvePool.push_back();
-        node->curve->addPoint(position, detailParam.thickness);
-        node->range.x() = 0;
+        curve = uint(_curves.size());
+        _curves.push_back(uivec2(uint(_points.size()), 0));
+        addPoint(curve, position, detailParam.thickness);
+        range.x() = 0;
     }
     else
     {
-        node->curve = parent->curve;
-        node->range.x() = node->curve->numPoints()-1;
+        curve = _nodes.curve[parent];
+        range.x() = _curves[curve].y()-1;
     }
+    const uint node = addNode(parent, curve);
 
     // generate curve
-    vec3 pointAtStart = node->curve->point(node->range.x());
+    vec3 pointAtStart = curvePoint(curve, range.x());
     float curveLength = isTrunk ? (param.trunkStepSize(_randEngine) * detailParam.trunkDecay) :
                                   (detailParam.branchSize * param.branchSizeCoef(_randEngine));
     vec3 pointAtEnd = pointAtStart + direction*curveLength;
@@ -87,7 +291,8 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
     else if(curveResolution <= 0)
         curveResolution = 1;
 
-    node->range.y() = node->range.x() + curveResolution;
+    range.y() = range.x() + curveResolution;
+    _nodes.range[node] = range;
 
     vec3 localDir = (pointAtEnd - pointAtStart) / (float)curveResolution;
     float localDirLength = localDir.length();
@@ -110,7 +315,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
         localDir = Quat::from_axis_angle(localDir.cross(vec3(_random(_randEngine), _random(_randEngine), _random(_randEngine))-vec3(0.5,0.5,0.5)).normalized(),
             param.branchJitter(_randEngine)*PI*(isTrunk?(float(i)/curveResolution):1))(localDir);
 
-        node->curve->addPoint(curPts, interpolate(detailParam.thickness, endThickness, float(i+1)/curveResolution));
+        addPoint(curve, curPts, interpolate(detailParam.thickness, endThickness, float(i+1)/curveResolution));
     }
     pointAtEnd = curPts;
 
@@ -118,7 +323,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
     bool trunkContinue = isTrunk && detailParam.inBranchDepth+1 < param.nbTrunkStep;
     if(trunkContinue)
     {
-        vec3 dir = genDir(node->curve->computeDirection(node->range.x()),
+        vec3 dir = genDir(curveDirection(curve, range.x()),
                           _random(_randEngine)*TAU,
                           toRad(param.trunkAngle(_randEngine)));
 
@@ -131,7 +336,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
         newGenParam.needNewCurve = false;
         newGenParam.isTrunk = true;
 
-        node->child = generateBranchRec(param, node, pointAtEnd, dir, newGenParam);
+        growBranch(param, node, pointAtEnd, dir, newGenParam);
     }
     // now the full curve is generated
 
@@ -141,7 +346,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
 		if (isTrunk && float(detailParam.inBranchDepth+1) < param.trunkBranchRange.x())
 			return node;
 
-        vec3 baseDir = node->curve->computeDirection(node->range.x());
+        vec3 baseDir = curveDirection(curve, range.x());
         float theta = _random(_randEngine)*TAU;
         float phi = toRad(param.branchAngle(_randEngine) * (trunkContinue ? 1:param.firstBranchAngleCoef(_randEngine)));
 
@@ -161,11 +366,8 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
 
         if(newGenParam.branchSize > param.branchSizeStopThreshold)
         {
-            Node* firstNewSplittedBranch = generateBranchRec(param, node, pointAtEnd, dir, newGenParam);
-            if(!trunkContinue)
-                node->child = firstNewSplittedBranch;
-            else
-                node->nodes.push_back(firstNewSplittedBranch);
+            // without the trunk, the first branch continues the curve
+            growBranch(param, node, pointAtEnd, dir, newGenParam);
 
             newGenParam.inBranchDepth=0;
             newGenParam.needNewCurve=true;
@@ -180,7 +382,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
                 newGenParam.branchSize = (isTrunk ? param.initialBranchSize : newGenParam.branchSize*param.branchSizeDecay(_randEngine)) * coef;
 
                 if(newGenParam.branchSize > param.branchSizeStopThreshold)
-                    node->nodes.push_back( generateBranchRec(param, node, pointAtEnd, dir, newGenParam));
+                    growBranch(param, node, pointAtEnd, dir, newGenParam);
             }
         }
 
@@ -211,7 +413,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
 
             float coef = isTrunk ? param.branchSizeAlongTrunk(onBranchPosSample + float(detailParam.inBranchDepth)) : 1;
 
-            vec3 branchPos = sampleSubCurve(onBranchPos, *node->curve, node->range, branchDir, atBranchThickness);
+            vec3 branchPos = sampleSubCurve(onBranchPos, curve, range, branchDir, atBranchThickness);
 
             onBranchPos *= sizeBranch;
             float theta = _random(_randEngine)*TAU;
@@ -239,7 +441,7 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
 
             branchDir = genDir(branchDir, theta, phi);
             if(newGenParam.branchSize > param.branchSizeStopThreshold)
-                node->nodes.push_back( generateBranchRec(param, node, branchPos, branchDir, newGenParam) );
+                growBranch(param, node, branchPos, branchDir, newGenParam);
         }
         }
     }
@@ -247,75 +449,44 @@ LTree::Node* LTree::generateBranchRec(const Parameter& param, Node* parent, vec3
     return node;
 }
 
-void LTree::accumulateMesh(Mesh& acc, const LTree::Node* node, int depth)
-{
-    if(depth == 0)
-        acc += node->curve->convertToWireMesh();
-
-    if(node->child)
-        accumulateMesh(acc, node->child, depth + 1);
-
-    for(Node* n : node->nodes)
-        accumulateMesh(acc, n, 0);
-}
-
-void LTree::generateMeshRec(Node* node, Mesh& mesh, int resolution, int depth) const
+void LTree::growBranch(const Parameter& param, uint parent, vec3 position, vec3 direction, const GenParam& detail)
 {
-    if(depth == 0)
-        mesh += node->curve->convertToMesh(resolution, true, true);
-
-    if(node->child)
-        generateMeshRec(node->child, mesh, resolution, depth+1);
-
-    for(auto child : node->nodes)
-        generateMeshRec(child, mesh, resolution, 0);
+    if(_deferBranches && detail.needNewCurve)
+        _pendingBranches.push_back({ parent, position, direction, detail, branchSeed(_branchSeed, uint(_pendingBranches.size()) + 1) });
+    else
+        generateBranchRec(param, parent, position, direction, detail);
 }
 
-void LTree::generateUVMeshRec(Node* node, UVMesh& mesh, int resolution, int depth) const
+void LTree::addTubes(eastl::vector<Curve>& curves, TubeMesher& mesher) const
 {
-    if(depth == 0)
-        mesh += node->curve->convertToUVMesh(resolution, true, true);
+    curves.resize(_curves.size());
+    for(uint c = 0 ; c < uint(_curves.size()) ; ++c)
+        curves[c] = makeCurve(c);
 
-    if(node->child)
-        generateUVMeshRec(node->child, mesh, resolution, depth+1);
-
-    for(auto child : node->nodes)
-        generateUVMeshRec(child, mesh, resolution, 0);
+    for(const Curve& curve : curves)
+        mesher.addTube(curve);
 }
 
-uint LTree::generateLeafRec(const LeafParameter& leaf, Node* node, Mesh& acc) const
+void LTree::generateNodeLeaves(const LeafParameter& leaf, uint node, Mesh& acc) const
 {
-    uint depth = 1 << 31;
-    if(node->child)
-    {
-        depth = generateLeafRec(leaf, node->child, acc);
-        for(auto n : node->nodes)
-            generateLeafRec(leaf, n, acc);
-    }
+    const uint curve = _nodes.curve[node];
+    const uivec2 range = _nodes.range[node];
 
-    if(!node->child || depth <= leaf.depth)
+    float nbLeaff =  (curvePoint(curve, range.y())-curvePoint(curve, range.x())).length() * leaf.density(_randEngine);
+    int nbLeaf = int(nbLeaff) + (_random(_randEngine) < fmodf(nbLeaff, 1) ? 1:0);
+    for(int i=0 ; i<nbLeaf ; ++i)
     {
-        float nbLeaff =  (node->curve->point(node->range.y())-node->curve->point(node->range.x())).length() * leaf.density(_randEngine);
-        int nbLeaf = int(nbLeaff) + (_random(_randEngine) < fmodf(nbLeaff, 1) ? 1:0);
-        for(int i=0 ; i<nbLeaf ; ++i)
-        {
-            vec3 dir; float thickness;
-            vec3 pos = sampleSubCurve(_random(_randEngine), *(node->curve), node->range, dir, thickness);
-            vec3 ortho = dir.cross(vec3(0,0,1));
-            vec3 up = ortho.cross(dir);
+        vec3 dir; float thickness;
+        vec3 pos = sampleSubCurve(_random(_randEngine), curve, range, dir, thickness);
+        vec3 ortho = dir.cross(vec3(0,0,1));
+        vec3 up = ortho.cross(dir);
 
-            mat3 orientation = mat3({dir, ortho, up});
-            acc += leaf.leaf.scaled(vec3::construct(leaf.scale(_randEngine)))
+        mat3 orientation = mat3({dir, ortho, up});
+        leaf.leaf.deferred().scaled(vec3::construct(leaf.scale(_randEngine)))
                             .rotated(Quat::from_axis_angle(ortho, leaf.tilt(_randEngine)))
                             .rotated(Quat::from_axis_angle(up, (_randEngine()%2==0 ? -1:1) * leaf.orientation(_randEngine)))
-                            .rotated(orientation).translated(pos);
-        }
+                            .rotated(orientation).translated(pos).appendTo(acc);
     }
-
-    if(!node->child)
-        return 0;
-    else
-        return depth + 1;
 }
 
 vec3 LTree::genDir(vec3 baseDir, float theta, float phi)
@@ -337,7 +508,7 @@ int LTree::randInt(ivec2 r) const
     return r.x() + (_randEngine() % (1+r.y()-r.x()));
 }
 
-vec3 LTree::sampleSubCurve(float sample, Curve& curve, uivec2 range, vec3& dir, float& thickness)
+vec3 LTree::sampleSubCurve(float sample, uint curve, uivec2 range, vec3& dir, float& thickness) const
 {
     float x = float(range.x()) + (range.y() - range.x()) * sample;
 
@@ -345,9 +516,9 @@ vec3 LTree::sampleSubCurve(float sample, Curve& curve, uivec2 range, vec3& dir,
     uint ix2 = std::max<uint>(std::min<uint>(ix+1, range[1]), range[0]);
     x = fmodf(x, 1);
 
-    dir = interpolate(curve.computeDirection(ix), curve.computeDirection(ix2), x);
-    thickness = interpolate(curve.radius(ix), curve.radius(ix2), x);
-    return interpolate(curve.point(ix), curve.point(ix2), x);
+    dir = interpolate(curveDirection(curve, ix), curveDirection(curve, ix2), x);
+    thickness = interpolate(curveRadius(curve, ix), curveRadius(curve, ix2), x);
+    return interpolate(curvePoint(curve, ix), curvePoint(curve, ix2), x);
 }
 
 namespace
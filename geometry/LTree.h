@@ -1,11 +1,11 @@
 #pragma once
 
 #include "Curve.h"
+#include "TubeMesher.h"
 #include "Mesh.h"
 #include "math/Quaternion.h"
 #include "math/PDF.h"
 #include "math/SampleFunction.h"
-#include <EASTL/deque.h>
 
 #include <random>
 
@@ -88,7 +88,12 @@ namespace tim
 			static LeafParameter gen(int seed, int sizeCategorie);
         };
 
-        LTree(Parameter, int seed=42);
+        /* PARALLEL grows every branch with its own random stream, derived from the seed and the path to the branch,
+           the sibling branches being grown by tasks on the thread pool. The tree does not depend on the number of threads
+           but differs from the SEQUENTIAL one of the same seed. */
+        enum GrowthMode { SEQUENTIAL, PARALLEL };
+
+        LTree(Parameter, int seed=42, GrowthMode = SEQUENTIAL);
         ~LTree() = default;
 
         LTree(const LTree&) = default;
@@ -98,8 +103,9 @@ namespace tim
         LTree& operator=(LTree&&) = default;
 
         void exportOBJ(eastl::string) const;
-        Mesh generateMesh(int resolution = 8) const;
-        UVMesh generateUVMesh(int resolution = 8) const;
+        /* maxError > 0 adapts the number of sides and rings of each branch, see TubeMesher */
+        Mesh generateMesh(int resolution = 8, float maxError = 0) const;
+        UVMesh generateUVMesh(int resolution = 8, float maxError = 0) const;
         Mesh generateLeaf(const LeafParameter&) const;
 
         enum PredefinedTree { TREE_1, TREE_2, TREE_3, TREE_4,
@@ -110,31 +116,29 @@ namespace tim
 		static MeshingParameter getPredefinedMeshing(PredefinedMeshing);
 
     private:
-        struct Node
-        {
-            Node* parent;
+        static const uint NO_NODE = uint(-1);
 
-            Curve* curve;
-            uivec2 range;
+        /* The nodes in the order of their generation, depth first, so a parent is before its children.
+           The first child of a node continues its curve when it has the same curve, the other children start a new one. */
+        struct Nodes
+        {
+            eastl::vector<uint> parent, firstChild, nextSibling;
+            eastl::vector<uint> curve;
+            eastl::vector<uivec2> range; // points of the curve along the node, relative to the start of the curve
 
-            Node* child;
-            eastl::vector<Node*> nodes;
-            //float branchPosition, branchAngle, thickness;
+            uint size() const { return uint(parent.size()); }
         };
 
-        Node* _root = nullptr;
+        Nodes _nodes;
 
-        eastl::deque<Node, EASTLAllocatorType, 256> _nodePool;
-        eastl::deque<Curve, EASTLAllocatorType, 256> _curvePool;
+        /* The points of all the curves, a curve is a contiguous range of them (x=first, y=number of points) */
+        eastl::vector<vec3> _points;
+        eastl::vector<float> _radius;
+        eastl::vector<uivec2> _curves;
 
         mutable std::mt19937 _randEngine;
         mutable std::uniform_real_distribution<float> _random;
 
-    private:
-        static void accumulateMesh(Mesh&, const Node*, int depth);
-        void generateMeshRec(Node*, Mesh&, int, int) const;
-        void generateUVMeshRec(Node*, UVMesh&, int, int) const;
-
         struct GenParam
         {
             float branchSize;
@@ -146,11 +150,43 @@ namespace tim
             float trunkDecay=1;
         };
 
-        Node* generateBranchRec(const Parameter&, Node* parent, vec3 position, vec3 direction, GenParam detailParam);
+        /* A branch starting a new curve, left to another task by the parallel growth */
+        struct PendingBranch
+        {
+            uint parent;
+            vec3 position, direction;
+            GenParam detail;
+            uint seed;
+        };
+
+        bool _deferBranches = false;
+        uint _branchSeed = 0;
+        eastl::vector<PendingBranch> _pendingBranches;
+
+    private:
+        explicit LTree(uint branchSeed); // a subtree of the parallel growth
+
+        void growParallel(const Parameter&, const GenParam&, int seed);
+        uint append(const LTree&, uint parent); // returns the index of its first node
+
+        uint addNode(uint parent, uint curve);
+        void linkChild(uint parent, uint node);
+        uint continuation(uint node) const; // the first child if it continues the curve of the node, NO_NODE otherwise
+
+        void addPoint(uint curve, vec3, float radius);
+        vec3 curvePoint(uint curve, uint index) const;
+        float curveRadius(uint curve, uint index) const;
+        vec3 curveDirection(uint curve, uint index) const;
+        Curve makeCurve(uint curve) const;
+
+        void addTubes(eastl::vector<Curve>&, TubeMesher&) const;
+
+        uint generateBranchRec(const Parameter&, uint parent, vec3 position, vec3 direction, GenParam detailParam);
+        void growBranch(const Parameter&, uint parent, vec3 position, vec3 direction, const GenParam&);
 
-        uint generateLeafRec(const LeafParameter&, Node*, Mesh&) const;
+        void generateNodeLeaves(const LeafParameter&, uint node, Mesh&) const;
 
-        static vec3 sampleSubCurve(float sample, Curve& curve, uivec2 range, vec3& dir, float& thickness);
+        vec3 sampleSubCurve(float sample, uint curve, uivec2 range, vec3& dir, float& thickness) const;
 
         static float mapRange(float, vec2);
         int randInt(ivec2) const;
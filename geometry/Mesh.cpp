@@ -1,4 +1,7 @@
 #include "Mesh.h"
+#include "ObjFile.h"
+#include "GridBuilder.h"
+#include "math/BoundingVolume.h"
 #include <iostream>
 #include <EASTL/unordered_map.h>
 
@@ -47,87 +50,142 @@ BaseMesh& BaseMesh::operator+=(const BaseMesh& mesh)
 
 BaseMesh BaseMesh::scaled(vec3 scale) const
 {
-    return BaseMesh(*this).mapVertices([&](vec3 v){ return v*scale; })
-                          .mapNormals([&](vec3 n){ return (n*scale).normalized(); });
+    return deferred().scaled(scale).apply();
 }
 
 BaseMesh BaseMesh::translated(vec3 translation) const
 {
-    return BaseMesh(*this).mapVertices([&](vec3 v){ return v+translation; });
+    return deferred().translated(translation).apply();
 }
 
-
 BaseMesh BaseMesh::transformed(const mat4& tr) const
 {
-    mat3 rot = tr.to<3>();
-    return BaseMesh(*this).mapVertices([&](vec3 v){ return tr*v; })
-                          .mapNormals([&](vec3 n) { return rot*n; });
+    return deferred().transformed(tr).apply();
 }
 
 BaseMesh BaseMesh::rotated(Quat rot) const
 {
-    return BaseMesh(*this).mapVertices(rot).mapNormals(rot);
+    return deferred().rotated(rot).apply();
 }
 
 BaseMesh BaseMesh::rotated(const mat3& rot) const
 {
-    return BaseMesh(*this).mapVertices([&](vec3 v){ return rot*v; })
-                          .mapNormals([&](vec3 n) { return rot*n; });
+    return deferred().rotated(rot).apply();
 }
 
-void BaseMesh::exportToObj(string filename) const
+BaseMesh& BaseMesh::scale(vec3 s)
+{
+    return transform(mat4::Scale(s));
+}
+
+BaseMesh& BaseMesh::translate(vec3 translation)
+{
+    return mapVertices([&](vec3 v){ return v+translation; });
+}
+
+BaseMesh& BaseMesh::transform(const mat4& tr)
+{
+    mat3 normalMat = tr.to<3>().inverted().transposed();
+    return mapVertices([&](vec3 v){ return tr*v; })
+           .mapNormals([&](vec3 n) { return (normalMat*n).normalized(); });
+}
+
+BaseMesh& BaseMesh::rotate(const Quat& rot)
+{
+    return mapVertices(rot).mapNormals(rot);
+}
+
+BaseMesh& BaseMesh::rotate(const mat3& rot)
+{
+    return mapVertices([&](vec3 v){ return rot*v; })
+           .mapNormals([&](vec3 n) { return rot*n; });
+}
+
+/* DeferredTransform */
+
+DeferredTransform& DeferredTransform::scaled(vec3 scale)
+{
+    _matrix = mat4::Scale(scale) * _matrix;
+    return *this;
+}
+
+DeferredTransform& DeferredTransform::translated(vec3 translation)
+{
+    _matrix = mat4::Translation(translation) * _matrix;
+    return *this;
+}
+
+DeferredTransform& DeferredTransform::transformed(const mat4& tr)
 {
-    std::ofstream out(filename.c_str());
-    if(!out)
+    _matrix = tr * _matrix;
+    return *this;
+}
+
+DeferredTransform& DeferredTransform::rotated(const Quat& rot)
+{
+    // the columns are the rotated basis
+    return rotated(mat3(mat3({ rot(vec3(1,0,0)), rot(vec3(0,1,0)), rot(vec3(0,0,1)) }).transposed()));
+}
+
+DeferredTransform& DeferredTransform::rotated(const mat3& rot)
+{
+    _matrix = rot.to<4>() * _matrix;
+    return *this;
+}
+
+mat3 DeferredTransform::normalMatrix() const
+{
+    return _matrix.to<3>().inverted().transposed();
+}
+
+BaseMesh DeferredTransform::apply() const
+{
+    return apply([](vec3 v) { return v; });
+}
+
+void DeferredTransform::appendTo(BaseMesh& mesh) const
+{
+    if (&mesh == _mesh)
     {
-        std::cerr << "Unuable to open " << filename.c_str() << std::endl;
+        mesh += apply();
         return;
     }
 
-    if(_vertices.empty())
-        return;
+    // same rules as +=, the attributes are only kept if both meshes have them
+    const bool empty = mesh._vertices.empty();
+    const bool withNormals = !_mesh->_normals.empty() && (empty || !mesh._normals.empty());
+    const bool withUV = !_mesh->_texCoords.empty() && (empty || !mesh._texCoords.empty());
+    const uint startIndex = mesh._vertices.size();
+    const mat3 normalMat = normalMatrix();
 
-    for(auto v : _vertices)
-    {
-        out << "v " << v.x() << " " << v.y() << " " << v.z() <<  "\n";
-    }
+    mesh._vertices.reserve(mesh._vertices.size() + _mesh->_vertices.size());
+    for (const vec3& v : _mesh->_vertices)
+        mesh._vertices.push_back(_matrix * v);
 
-    for(auto v : _normals)
+    if (withNormals)
     {
-        out << "vn " << v.x() << " " << v.y() << " " << v.z() <<  "\n";
+        for (const vec3& n : _mesh->_normals)
+            mesh._normals.push_back((normalMat * n).normalized());
     }
 
-    for(auto v : _texCoords)
-    {
-        out << "vt " << v.x() << " " << v.y() <<  "\n";
-    }
+    if (withUV)
+        mesh._texCoords.insert(mesh._texCoords.end(), _mesh->_texCoords.begin(), _mesh->_texCoords.end());
 
-    for(auto f : _faces)
+    mesh._faces.reserve(mesh._faces.size() + _mesh->_faces.size());
+    for (const auto& f : _mesh->_faces)
     {
-        switch(f.nbIndexes)
-        {
-        case 0:
-        case 1:
-        default:
-            break;
-
-        case 2:
-            out << "l ";
-            writeVertex(out, f.indexes[0]) << " ";
-            writeVertex(out, f.indexes[1]) <<  "\n";
-            break;
-
-        case 3:
-        case 4:
-            out << "f ";
-            for(int i=0 ; i<f.nbIndexes ; ++i)
-                writeVertex(out, f.indexes[i]) << " ";
-            out << "\n";
-            break;
-        }
+        BaseMesh::Face face = f;
+        for (int i = 0; i < f.nbIndexes; ++i)
+            face.indexes[i] += startIndex;
+        mesh._faces.push_back(face);
     }
 }
 
+void BaseMesh::exportToObj(string filename) const
+{
+    ObjFile::write(*this, filename);
+}
+
 BaseMesh& BaseMesh::computeNormals(bool correctSeems, int smooth)
 {
     _normals.clear();
@@ -293,65 +351,17 @@ vec3 BaseMesh::faceNormal(uint faceIndex) const
     return v1.cross(v2).normalized();
 }
 
-std::ofstream& BaseMesh::writeVertex(std::ofstream& out, uint index) const
-{
-    ++index;
-    if(_normals.empty() && _texCoords.empty())
-		out << index;
-	else if(_normals.empty())
-		out << index << "/" << index;
-	else if (_texCoords.empty())
-		out << index << "//" << index;
-	else
-		out << index << "/" << index << "/" << index;
-
-    return out;
-}
-
 void BaseMesh::generateGrid(BaseMesh& mesh, vec2 size, uivec2 resolution, const ImageAlgorithm<float>& heightmap, float Zscale, bool withUV, bool triangulate)
 {
-	if (resolution.x() <= 1 || resolution.y() <= 1)
-		return;
-
-	vec2 d = { size.x() / (resolution.x()-1), size.y() / (resolution.y()-1) };
-	vec2 d_img;
-
-	if(!heightmap.empty())
-		d_img = vec2(float(heightmap.size().x()) / (resolution.x() - 1), float(heightmap.size().y()) / (resolution.y() - 1));
-
-	eastl::vector<eastl::vector<uint>> indexes(resolution.x(), eastl::vector<uint>(resolution.y()));
-    uint curIndex = 0;
-	
-	for (uint i = 0; i < resolution.x(); ++i)
-	{
-		for (uint j = 0; j < resolution.y(); ++j)
-		{
-			vec3 p = vec3(d.x()*i, d.y()*j, 0) - vec3(size*0.5, 0);
-
-			if (!heightmap.empty())
-				p.z() = heightmap.getSmooth(d_img * vec2(i, j)) * Zscale;
-
-			mesh._vertices.push_back(p);
-			indexes[i][j] = curIndex++;
+	GridBuilder::Parameter param;
+	param.size = size;
+	param.resolution = resolution;
+	param.heightmap = &heightmap;
+	param.zScale = Zscale;
+	param.withUV = withUV;
+	param.triangulate = triangulate;
 
-			if (withUV)
-			{
-				vec2 uv(float(i) / (resolution.x() - 1), float(j) / (resolution.y() - 1));
-				mesh._texCoords.push_back(uv);
-			}
-
-			if (i > 0 && j > 0)
-			{
-				if (triangulate)
-				{
-					mesh.addFace({ { indexes[i - 1][j - 1], indexes[i][j - 1], indexes[i][j], 0 }, 3 });
-					mesh.addFace({ { indexes[i][j], indexes[i-1][j], indexes[i-1][j-1], 0 }, 3 });
-				}
-				else
-					mesh.addFace({ { indexes[i - 1][j - 1], indexes[i][j - 1], indexes[i][j], indexes[i - 1][j] }, 4 });
-			}
-		}
-	}
+	GridBuilder::build(mesh, param);
 }
 
 void BaseMesh::clearFaces()
@@ -397,7 +407,7 @@ void BaseMesh::computeJoinNormals(eastl::vector<BaseMesh*>& meshs, int smooth)
 
 Sphere BaseMesh::computeBoundingSphere()
 {
-	return Sphere::computeSphere(reinterpret_cast<float*>(_vertices.data()), _vertices.size(), 3);
+	return BoundingVolume::minimalSphere(reinterpret_cast<const float*>(_vertices.data()), _vertices.size());
 }
 
 /* Mesh */
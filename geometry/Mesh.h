@@ -14,9 +14,23 @@
 namespace tim
 {
     class Curve;
+    class DeferredTransform;
+
     class BaseMesh
 	{
         friend class Curve;
+        friend class DeferredTransform;
+        friend class MeshSimplifier;
+        friend class MeshOptimizer;
+        friend class MeshEncoder;
+        friend class MeshFile;
+        friend class MeshFileWriter;
+        friend class ObjFile;
+        friend class GridBuilder;
+        friend class MeshletBuilder;
+        friend class HalfEdgeMesh;
+        friend class TubeMesher;
+        friend class CubeSphere;
 
     public:
         struct Face
@@ -41,6 +55,16 @@ namespace tim
         BaseMesh rotated(Quat) const;
         BaseMesh rotated(const mat3&) const;
 
+        /* Accumulate the transforms and apply them in one pass, see DeferredTransform */
+        DeferredTransform deferred() const;
+
+        /* In place, for the meshes we own */
+        BaseMesh& scale(vec3);
+        BaseMesh& translate(vec3);
+        BaseMesh& transform(const mat4&);
+        BaseMesh& rotate(const Quat&);
+        BaseMesh& rotate(const mat3&);
+
         template<class T> BaseMesh& mapVertices(const T&);
         template<class T> BaseMesh& mapNormals(const T&);
 
@@ -83,8 +107,6 @@ namespace tim
         void buildVertexFaceMap(bool useRealPosition);
 
    private:
-        std::ofstream& writeVertex(std::ofstream&, uint) const;
-
         vec3 faceNormal(uint) const;
 
 	protected:
@@ -113,6 +135,57 @@ namespace tim
         return *this;
     }
 
+	/* Affine transforms accumulated on a mesh, applied in a single pass over the vertices instead of a copy
+	   of the whole mesh for each scaled/translated/rotated. The matrix can also be folded in an instance transform.
+	   The source mesh must outlive the DeferredTransform. */
+	class DeferredTransform
+	{
+	public:
+		explicit DeferredTransform(const BaseMesh& mesh) : _mesh(&mesh), _matrix(mat4::IDENTITY()) {}
+
+		DeferredTransform& scaled(vec3);
+		DeferredTransform& translated(vec3);
+		DeferredTransform& transformed(const mat4&);
+		DeferredTransform& rotated(const Quat&);
+		DeferredTransform& rotated(const mat3&);
+
+		const mat4& matrix() const { return _matrix; }
+
+		/* A transformed copy, mapVertex is fused in the same pass and applied after the transform */
+		BaseMesh apply() const;
+		template<class F> BaseMesh apply(const F& mapVertex) const;
+
+		/* Transform the source into an existing mesh, as its += would do, without temporary */
+		void appendTo(BaseMesh&) const;
+
+	private:
+		const BaseMesh* _mesh;
+		mat4 _matrix;
+
+		mat3 normalMatrix() const;
+	};
+
+	inline DeferredTransform BaseMesh::deferred() const { return DeferredTransform(*this); }
+
+	template<class F> BaseMesh DeferredTransform::apply(const F& mapVertex) const
+	{
+		const mat3 normalMat = normalMatrix();
+
+		BaseMesh result;
+		result._faces = _mesh->_faces;
+		result._texCoords = _mesh->_texCoords;
+
+		result._vertices.resize(_mesh->_vertices.size());
+		for (size_t i = 0; i < _mesh->_vertices.size(); ++i)
+			result._vertices[i] = mapVertex(_matrix * _mesh->_vertices[i]);
+
+		result._normals.resize(_mesh->_normals.size());
+		for (size_t i = 0; i < _mesh->_normals.size(); ++i)
+			result._normals[i] = (normalMat * _mesh->_normals[i]).normalized();
+
+		return result;
+	}
+
 	/* Mesh */
 
     class Mesh : public BaseMesh
@@ -0,0 +1,281 @@
+#include "MeshEncoder.h"
+
+#include <cstdint>
+
+namespace tim
+{
+
+namespace
+{
+	uint16_t quantizeUnorm16(float v)
+	{
+		v = eastl::min(eastl::max(v, 0.f), 1.f);
+		return uint16_t(v * 65535.f + 0.5f);
+	}
+
+	float dequantizeUnorm16(uint16_t v) { return float(v) / 65535.f; }
+
+	template<int MAX>
+	float dequantizeSnorm(int v) { return eastl::max(float(v) / MAX, -1.f); }
+
+	/* Round to the snorm grid, trying the 4 neighbours to keep the one closest to the normal */
+	template<class T, int MAX>
+	void quantizeOctahedral(vec3 normal, T& x, T& y)
+	{
+		vec2 e = MeshEncoder::encodeOctahedral(normal);
+
+		float fx = floorf(e.x() * MAX), fy = floorf(e.y() * MAX);
+		float bestDot = -2;
+
+		for (int i = 0; i < 4; ++i)
+		{
+			int qx = eastl::min(eastl::max(int(fx) + (i & 1), -MAX), MAX);
+			int qy = eastl::min(eastl::max(int(fy) + (i >> 1), -MAX), MAX);
+
+			float d = MeshEncoder::decodeOctahedral(vec2(float(qx) / MAX, float(qy) / MAX)).dot(normal);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				x = T(qx);
+				y = T(qy);
+			}
+		}
+	}
+
+	template<class T>
+	void write(byte* dst, T value) { memcpy(dst, &value, sizeof(T)); }
+
+	template<class T>
+	T read(const byte* src) { T value; memcpy(&value, src, sizeof(T)); return value; }
+}
+
+vec2 MeshEncoder::encodeOctahedral(vec3 n)
+{
+	float l1 = fabsf(n.x()) + fabsf(n.y()) + fabsf(n.z());
+	if (l1 == 0)
+		return vec2(0, 0);
+
+	vec2 e(n.x() / l1, n.y() / l1);
+	if (n.z() < 0)
+	{
+		// fold the lower hemisphere on the corners
+		vec2 folded((1 - fabsf(e.y())) * (e.x() >= 0 ? 1.f : -1.f), (1 - fabsf(e.x())) * (e.y() >= 0 ? 1.f : -1.f));
+		e = folded;
+	}
+	return e;
+}
+
+vec3 MeshEncoder::decodeOctahedral(vec2 e)
+{
+	vec3 n(e.x(), e.y(), 1 - fabsf(e.x()) - fabsf(e.y()));
+	float t = eastl::max(-n.z(), 0.f);
+	n.x() += n.x() >= 0 ? -t : t;
+	n.y() += n.y() >= 0 ? -t : t;
+	return n.normalized();
+}
+
+uint MeshEncoder::vertexStride(const Parameter& param)
+{
+	return 8 + (param.normals == OCT_SNORM16 ? 4 : 0) + (param.withUV ? 4 : 0);
+}
+
+void MeshEncoder::computeBounds(const BaseMesh& mesh, vec3& minB, vec3& maxB)
+{
+	minB = vec3::construct(std::numeric_limits<float>::max());
+	maxB = -minB;
+	for (const vec3& v : mesh._vertices)
+	{
+		for (int a = 0; a < 3; ++a) minB[a] = eastl::min(minB[a], v[a]);
+		for (int a = 0; a < 3; ++a) maxB[a] = eastl::max(maxB[a], v[a]);
+	}
+
+	if (mesh._vertices.empty())
+		minB = maxB = vec3();
+}
+
+MeshEncoder::EncodedMesh MeshEncoder::encode(const BaseMesh& mesh, const Parameter& param)
+{
+	vec3 minB, maxB;
+	computeBounds(mesh, minB, maxB);
+	return encode(mesh, param, minB, maxB);
+}
+
+bool MeshEncoder::encodeOnLattice(const BaseMesh& mesh, const Parameter& param, float step, EncodedMesh& result)
+{
+	vec3 minB, maxB;
+	computeBounds(mesh, minB, maxB);
+
+	// 65535 steps exactly, a position on the lattice is quantized to its index from the snapped corner
+	const float span = step * 65535;
+	for (int a = 0; a < 3; ++a)
+	{
+		minB[a] = floorf(minB[a] / step) * step;
+		if (maxB[a] - minB[a] > span)
+			return false;
+	}
+
+	result = encode(mesh, param, minB, minB + vec3::construct(span));
+	return true;
+}
+
+float MeshEncoder::latticeStep(float extent)
+{
+	int exponent;
+	frexpf(eastl::max(extent, std::numeric_limits<float>::min()) / 65534, &exponent);
+	return ldexpf(1, exponent);
+}
+
+MeshEncoder::EncodedMesh MeshEncoder::encode(const BaseMesh& mesh, const Parameter& param, vec3 boundsMin, vec3 boundsMax)
+{
+	EncodedMesh result;
+	result.format = param;
+	result.nbVertices = mesh.nbVertices();
+
+	// the layout always follows the parameter so it matches the input layout, missing attributes are left to 0
+	const bool withNormals = param.normals != NO_NORMAL && mesh._normals.size() == mesh._vertices.size();
+	const bool withUV = param.withUV && mesh._texCoords.size() == mesh._vertices.size();
+
+	result.stride = vertexStride(param);
+	result.uvOffset = 8 + (param.normals == OCT_SNORM16 ? 4 : 0);
+
+	// uniform scale, so the decoding keeps the normals orthogonal to the surface
+	vec3 extent = boundsMax - boundsMin;
+	float scale = eastl::max(extent.x(), eastl::max(extent.y(), extent.z()));
+	scale = scale > 0 ? scale : 1;
+	result.positionDecode = vec4(boundsMin.x(), boundsMin.y(), boundsMin.z(), scale);
+
+	vec2 uvMin, uvScale(1, 1);
+	if (withUV && !mesh._texCoords.empty())
+	{
+		vec2 uvMax = uvMin = mesh._texCoords[0];
+		for (const vec2& uv : mesh._texCoords)
+		{
+			for (int a = 0; a < 2; ++a) uvMin[a] = eastl::min(uvMin[a], uv[a]);
+			for (int a = 0; a < 2; ++a) uvMax[a] = eastl::max(uvMax[a], uv[a]);
+		}
+
+		for (int a = 0; a < 2; ++a)
+			uvScale[a] = uvMax[a] > uvMin[a] ? uvMax[a] - uvMin[a] : 1;
+	}
+	result.uvDecode = vec4(uvMin.x(), uvMin.y(), uvScale.x(), uvScale.y());
+
+	result.vertexData.resize(size_t(result.stride) * result.nbVertices);
+
+	for (uint i = 0; i < result.nbVertices; ++i)
+	{
+		byte* v = result.vertexData.data() + size_t(i) * result.stride;
+		vec3 p = (mesh._vertices[i] - boundsMin) / scale;
+
+		write(v, quantizeUnorm16(p.x()));
+		write(v + 2, quantizeUnorm16(p.y()));
+		write(v + 4, quantizeUnorm16(p.z()));
+		write(v + 6, uint16_t(0));
+
+		if (withNormals && param.normals == OCT_SNORM16)
+		{
+			int16_t x, y;
+			quantizeOctahedral<int16_t, 32767>(mesh._normals[i], x, y);
+			write(v + 8, x);
+			write(v + 10, y);
+		}
+		else if (withNormals && param.normals == OCT_SNORM8)
+		{
+			int8_t x, y;
+			quantizeOctahedral<int8_t, 127>(mesh._normals[i], x, y);
+			write(v + 6, int8_t(x));
+			write(v + 7, int8_t(y));
+		}
+
+		if (withUV)
+		{
+			vec2 uv = mesh._texCoords[i] - uvMin;
+			write(v + result.uvOffset, quantizeUnorm16(uv.x() / uvScale.x()));
+			write(v + result.uvOffset + 2, quantizeUnorm16(uv.y() / uvScale.y()));
+		}
+	}
+
+	return result;
+}
+
+void MeshEncoder::setPositionW(EncodedMesh& encoded, const float* values)
+{
+	if (encoded.format.normals == OCT_SNORM8)
+		return;
+
+	for (uint i = 0; i < encoded.nbVertices; ++i)
+		write(encoded.vertexData.data() + size_t(i) * encoded.stride + 6, quantizeUnorm16(values[i]));
+}
+
+BaseMesh MeshEncoder::decode(const EncodedMesh& encoded)
+{
+	BaseMesh mesh;
+	mesh._vertices.resize(encoded.nbVertices);
+	if (encoded.format.normals != NO_NORMAL)
+		mesh._normals.resize(encoded.nbVertices);
+	if (encoded.format.withUV)
+		mesh._texCoords.resize(encoded.nbVertices);
+
+	const vec3 offset(encoded.positionDecode.x(), encoded.positionDecode.y(), encoded.positionDecode.z());
+	const float scale = encoded.positionDecode.w();
+
+	for (uint i = 0; i < encoded.nbVertices; ++i)
+	{
+		const byte* v = encoded.vertexData.data() + size_t(i) * encoded.stride;
+
+		vec3 q(dequantizeUnorm16(read<uint16_t>(v)), dequantizeUnorm16(read<uint16_t>(v + 2)), dequantizeUnorm16(read<uint16_t>(v + 4)));
+		mesh._vertices[i] = q * scale + offset;
+
+		if (encoded.format.normals == OCT_SNORM16)
+			mesh._normals[i] = decodeOctahedral(vec2(dequantizeSnorm<32767>(read<int16_t>(v + 8)), dequantizeSnorm<32767>(read<int16_t>(v + 10))));
+		else if (encoded.format.normals == OCT_SNORM8)
+			mesh._normals[i] = decodeOctahedral(vec2(dequantizeSnorm<127>(read<int8_t>(v + 6)), dequantizeSnorm<127>(read<int8_t>(v + 7))));
+
+		if (encoded.format.withUV)
+		{
+			vec2 q(dequantizeUnorm16(read<uint16_t>(v + encoded.uvOffset)), dequantizeUnorm16(read<uint16_t>(v + encoded.uvOffset + 2)));
+			mesh._texCoords[i] = vec2(q.x() * encoded.uvDecode.z() + encoded.uvDecode.x(), q.y() * encoded.uvDecode.w() + encoded.uvDecode.y());
+		}
+	}
+
+	return mesh;
+}
+
+MeshEncoder::ErrorReport MeshEncoder::computeError(const BaseMesh& original, const EncodedMesh& encoded)
+{
+	ErrorReport report;
+	BaseMesh decoded = decode(encoded);
+
+	const uint nbVertices = eastl::min(original.nbVertices(), decoded.nbVertices());
+	if (nbVertices == 0)
+		return report;
+
+	const bool withNormals = !decoded._normals.empty() && original._normals.size() == original._vertices.size();
+	const bool withUV = !decoded._texCoords.empty() && original._texCoords.size() == original._vertices.size();
+
+	for (uint i = 0; i < nbVertices; ++i)
+	{
+		float error = (original._vertices[i] - decoded._vertices[i]).length();
+		report.maxPositionError = eastl::max(report.maxPositionError, error);
+		report.meanPositionError += error;
+
+		if (withNormals && original._normals[i].length2() > 0)
+		{
+			float cosAngle = eastl::min(eastl::max(original._normals[i].normalized().dot(decoded._normals[i]), -1.f), 1.f);
+			float angle = toDeg(acosf(cosAngle));
+			report.maxNormalError = eastl::max(report.maxNormalError, angle);
+			report.meanNormalError += angle;
+		}
+
+		if (withUV)
+		{
+			vec2 d = original._texCoords[i] - decoded._texCoords[i];
+			report.maxUVError = eastl::max(report.maxUVError, eastl::max(fabsf(d.x()), fabsf(d.y())));
+		}
+	}
+
+	report.meanPositionError /= nbVertices;
+	report.meanNormalError /= nbVertices;
+	return report;
+}
+
+}
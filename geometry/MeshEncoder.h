@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Mesh.h"
+
+namespace tim
+{
+	/* Quantized vertex format for the gpu:
+	   - position : 4 x unorm16, relative to a box (the mesh bounds or a given tile box) with a uniform scale
+	   - normal : octahedral, 2 x snorm16 after the position, or 2 x snorm8 packed in the w component of the position
+	   - uv : 2 x unorm16 relative to the uv bounds of the mesh
+	   A vertex is 8 to 16 bytes instead of 24 to 32. The faces are not touched, the indexes stay valid. */
+	class MeshEncoder
+	{
+	public:
+		enum NormalEncoding { NO_NORMAL, OCT_SNORM16, OCT_SNORM8 };
+
+		struct Parameter
+		{
+			NormalEncoding normals = OCT_SNORM16;
+			bool withUV = true;
+		};
+
+		struct EncodedMesh
+		{
+			eastl::vector<byte> vertexData;
+			uint stride = 0;
+			uint nbVertices = 0;
+			uint uvOffset = 0; // in bytes inside a vertex
+
+			Parameter format;
+
+			vec4 positionDecode = { 0,0,0,1 }; // p = q * w + xyz, with q in [0,1]
+			vec4 uvDecode = { 0,0,1,1 }; // uv = q * zw + xy
+		};
+
+		struct ErrorReport
+		{
+			float maxPositionError = 0, meanPositionError = 0; // in mesh units
+			float maxNormalError = 0, meanNormalError = 0; // in degrees
+			float maxUVError = 0;
+		};
+
+		MeshEncoder() = delete;
+
+		/* In bytes, the same for every mesh encoded with the parameter */
+		static uint vertexStride(const Parameter&);
+
+		static EncodedMesh encode(const BaseMesh&, const Parameter&);
+
+		/* Quantize in the given box, to share the decoding between meshes or to use the tile bounds. Positions outside are clamped. */
+		static EncodedMesh encode(const BaseMesh&, const Parameter&, vec3 boundsMin, vec3 boundsMax);
+
+		/* Quantize on the lattice of a power of two step, in the box of the mesh snapped to it, so meshes encoded with the same step
+		   round an equal position to the same point whatever their bounds. False if the mesh spans more than 65535 steps. */
+		static bool encodeOnLattice(const BaseMesh&, const Parameter&, float step, EncodedMesh&);
+
+		/* The smallest power of two step covering the extent in 65535 steps from any corner snapped to the lattice */
+		static float latticeStep(float extent);
+
+		/* Store a value in [0,1] per vertex in the w component of the positions, free unless the normals are OCT_SNORM8 */
+		static void setPositionW(EncodedMesh&, const float* values);
+
+		/* Vertices, normals and uvs only, for validation */
+		static BaseMesh decode(const EncodedMesh&);
+
+		static ErrorReport computeError(const BaseMesh& original, const EncodedMesh&);
+
+		static vec2 encodeOctahedral(vec3 normal);
+		static vec3 decodeOctahedral(vec2);
+
+	private:
+		static void computeBounds(const BaseMesh&, vec3& boundsMin, vec3& boundsMax);
+	};
+}
@@ -0,0 +1,481 @@
+#include "MeshFile.h"
+#include "math/BoundingVolume.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace tim
+{
+
+namespace
+{
+	/* On disk layout, little endian, the offsets are from the start of the file and 0 means the stream is absent */
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t nbParts;
+		uint32_t reserved;
+		uint64_t fileSize;
+		uint64_t partTableOffset;
+	};
+
+	struct PartHeader
+	{
+		uint64_t streamOffsets[MeshFile::NB_STREAMS];
+		uint64_t streamSizes[MeshFile::NB_STREAMS];
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+
+		uint32_t nbVertices, nbIndices, nbLods, nbPointsInFace;
+		uint32_t encodedStride, normalEncoding, withUV, reserved;
+
+		float boundsMin[3], boundsMax[3];
+		float sphere[4];
+	};
+
+	static_assert(sizeof(FileHeader) == 32, "MeshFile header layout");
+	static_assert(sizeof(PartHeader) == 152, "MeshFile part layout");
+	static_assert(sizeof(MeshFile::Lod) == 64, "MeshFile lod layout");
+	static_assert(sizeof(vec3) == 12 && sizeof(vec2) == 8, "MeshFile streams are read as vectors");
+
+	size_t align(size_t offset) { return (offset + MeshFile::STREAM_ALIGNMENT - 1) / MeshFile::STREAM_ALIGNMENT * MeshFile::STREAM_ALIGNMENT; }
+
+	bool inside(uint64_t offset, uint64_t size, size_t fileSize) { return offset <= fileSize && size <= fileSize - offset; }
+
+	template<class T>
+	MeshFile::View<T> view(const byte* data, uint64_t offset, size_t count)
+	{
+		MeshFile::View<T> v;
+		if (offset != 0)
+		{
+			v.data = reinterpret_cast<const T*>(data + offset);
+			v.size = count;
+		}
+		return v;
+	}
+
+	template<class T>
+	void append(eastl::vector<byte>& out, const T* data, size_t count)
+	{
+		size_t offset = out.size();
+		out.resize(offset + sizeof(T) * count);
+		if (count > 0)
+			memcpy(out.data() + offset, data, sizeof(T) * count);
+	}
+
+	void createParentDirectory(const eastl::string& path)
+	{
+		size_t pos = path.find_last_of("/\\");
+		if (pos == eastl::string::npos || pos == 0)
+			return;
+
+		eastl::string dir = path.substr(0, pos);
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0755);
+#endif
+	}
+}
+
+MeshFile::~MeshFile()
+{
+	close();
+}
+
+bool MeshFile::open(const eastl::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	_data = (const byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	_size = size_t(size.QuadPart);
+	_mapping = mapping;
+	_file = file;
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(file, &st) != 0 || st.st_size <= 0)
+	{
+		::close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	_data = (const byte*)data;
+	_size = size_t(st.st_size);
+	_mapping = data;
+#endif
+
+	if (!parse())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::open(eastl::vector<byte>&& data)
+{
+	close();
+
+	_memory = eastl::move(data);
+	_data = _memory.empty() ? nullptr : _memory.data();
+	_size = _memory.size();
+
+	if (!parse())
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MeshFile::close()
+{
+#ifdef _WIN32
+	if (_mapping)
+	{
+		UnmapViewOfFile(_data);
+		CloseHandle((HANDLE)_mapping);
+		CloseHandle((HANDLE)_file);
+	}
+#else
+	if (_mapping)
+		munmap(_mapping, _size);
+#endif
+
+	_mapping = nullptr;
+	_file = nullptr;
+	_memory.clear();
+	_parts.clear();
+	_data = nullptr;
+	_size = 0;
+}
+
+bool MeshFile::parse()
+{
+	if (_data == nullptr || _size < sizeof(FileHeader))
+		return false;
+
+	FileHeader header;
+	memcpy(&header, _data, sizeof(header));
+
+	if (header.magic != MAGIC || header.version != VERSION || header.fileSize != _size ||
+		!inside(header.partTableOffset, uint64_t(header.nbParts) * sizeof(PartHeader), _size))
+		return false;
+
+	_parts.resize(header.nbParts);
+	for (uint i = 0; i < header.nbParts; ++i)
+	{
+		PartHeader ph;
+		memcpy(&ph, _data + header.partTableOffset + i * sizeof(PartHeader), sizeof(ph));
+
+		const uint64_t expectedSizes[NB_STREAMS] = { uint64_t(ph.nbVertices) * sizeof(vec3), uint64_t(ph.nbVertices) * sizeof(vec3),
+													 uint64_t(ph.nbVertices) * sizeof(vec2), uint64_t(ph.nbVertices) * ph.encodedStride };
+
+		for (int s = 0; s < NB_STREAMS; ++s)
+		{
+			if (ph.streamOffsets[s] == 0)
+				continue;
+
+			if (ph.streamOffsets[s] % STREAM_ALIGNMENT != 0 || ph.streamSizes[s] != expectedSizes[s] || !inside(ph.streamOffsets[s], ph.streamSizes[s], _size))
+				return false;
+		}
+
+		if (ph.indexOffset % STREAM_ALIGNMENT != 0 || !inside(ph.indexOffset, uint64_t(ph.nbIndices) * sizeof(uint), _size) ||
+			ph.lodOffset % STREAM_ALIGNMENT != 0 || !inside(ph.lodOffset, uint64_t(ph.nbLods) * sizeof(Lod), _size) ||
+			ph.nbPointsInFace == 0 || ph.nbPointsInFace > 4)
+			return false;
+
+		Part& part = _parts[i];
+		part.positions = view<vec3>(_data, ph.streamOffsets[POSITION], ph.nbVertices);
+		part.normals = view<vec3>(_data, ph.streamOffsets[NORMAL], ph.nbVertices);
+		part.texCoords = view<vec2>(_data, ph.streamOffsets[UV], ph.nbVertices);
+		part.encodedVertices = view<byte>(_data, ph.streamOffsets[ENCODED], size_t(ph.streamSizes[ENCODED]));
+		part.indices = view<uint>(_data, ph.indexOffset, ph.nbIndices);
+		part.lods = view<Lod>(_data, ph.lodOffset, ph.nbLods);
+
+		// the whole index stream is uploaded, and a lod only reads its own vertices
+		for (uint index : part.indices)
+		{
+			if (index >= ph.nbVertices)
+				return false;
+		}
+
+		for (const Lod& lod : part.lods)
+		{
+			if (uint64_t(lod.firstIndex) + lod.nbIndices > ph.nbIndices || uint64_t(lod.firstVertex) + lod.nbVertices > ph.nbVertices)
+				return false;
+
+			for (uint i = lod.firstIndex; i < lod.firstIndex + lod.nbIndices; ++i)
+			{
+				if (part.indices[i] < lod.firstVertex || part.indices[i] - lod.firstVertex >= lod.nbVertices)
+					return false;
+			}
+		}
+
+		part.nbVertices = ph.nbVertices;
+		part.nbPointsInFace = ph.nbPointsInFace;
+		part.encodedStride = ph.encodedStride;
+		part.encoding.normals = MeshEncoder::NormalEncoding(ph.normalEncoding);
+		part.encoding.withUV = ph.withUV != 0;
+		part.boundsMin = vec3(ph.boundsMin[0], ph.boundsMin[1], ph.boundsMin[2]);
+		part.boundsMax = vec3(ph.boundsMax[0], ph.boundsMax[1], ph.boundsMax[2]);
+		part.boundingSphere = Sphere(vec3(ph.sphere[0], ph.sphere[1], ph.sphere[2]), ph.sphere[3]);
+	}
+
+	return true;
+}
+
+BaseMesh MeshFile::extractMesh(const Part& part, uint lodIndex)
+{
+	BaseMesh mesh;
+	if (lodIndex >= part.lods.size)
+		return mesh;
+
+	const Lod& lod = part.lods[lodIndex];
+
+	if (!part.positions.empty())
+	{
+		mesh._vertices.assign(part.positions.begin() + lod.firstVertex, part.positions.begin() + lod.firstVertex + lod.nbVertices);
+		if (!part.normals.empty())
+			mesh._normals.assign(part.normals.begin() + lod.firstVertex, part.normals.begin() + lod.firstVertex + lod.nbVertices);
+		if (!part.texCoords.empty())
+			mesh._texCoords.assign(part.texCoords.begin() + lod.firstVertex, part.texCoords.begin() + lod.firstVertex + lod.nbVertices);
+	}
+	else if (!part.encodedVertices.empty())
+	{
+		MeshEncoder::EncodedMesh encoded;
+		encoded.stride = part.encodedStride;
+		encoded.nbVertices = lod.nbVertices;
+		encoded.uvOffset = 8 + (part.encoding.normals == MeshEncoder::OCT_SNORM16 ? 4 : 0);
+		encoded.format = part.encoding;
+		encoded.positionDecode = vec4(lod.positionDecode[0], lod.positionDecode[1], lod.positionDecode[2], lod.positionDecode[3]);
+		encoded.uvDecode = vec4(lod.uvDecode[0], lod.uvDecode[1], lod.uvDecode[2], lod.uvDecode[3]);
+
+		const byte* first = part.encodedVertices.data + size_t(lod.firstVertex) * part.encodedStride;
+		encoded.vertexData.assign(first, first + size_t(lod.nbVertices) * part.encodedStride);
+
+		mesh = MeshEncoder::decode(encoded);
+	}
+
+	for (uint i = 0; i + part.nbPointsInFace <= lod.nbIndices; i += part.nbPointsInFace)
+	{
+		BaseMesh::Face face;
+		face.nbIndexes = int(part.nbPointsInFace);
+		for (uint j = 0; j < part.nbPointsInFace; ++j)
+			face.indexes[j] = part.indices[lod.firstIndex + i + j] - lod.firstVertex;
+		mesh._faces.push_back(face);
+	}
+
+	return mesh;
+}
+
+uint64_t MeshFile::hash(const void* data, size_t size, uint64_t seed)
+{
+	const byte* ptr = (const byte*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		seed ^= ptr[i];
+		seed *= 1099511628211ull;
+	}
+	return seed;
+}
+
+void MeshFileWriter::addPart(const eastl::vector<Lod>& lods, const PartParameter& param)
+{
+	PartData part;
+	part.nbPointsInFace = param.nbPointsInFace;
+	part.encoding = param.encoding;
+
+	if (!lods.empty() && lods[0].mesh->nbVertices() > 0)
+	{
+		const BaseMesh& first = *lods[0].mesh;
+		const float* points = reinterpret_cast<const float*>(first._vertices.data());
+
+		BoundingVolume::Box box = BoundingVolume::computeBox(points, first.nbVertices());
+		part.boundsMin = box.min;
+		part.boundsMax = box.max;
+		part.boundingSphere = BoundingVolume::minimalSphere(points, first.nbVertices());
+	}
+
+	for (const Lod& lod : lods)
+	{
+		const BaseMesh& mesh = *lod.mesh;
+
+		MeshFile::Lod entry = {};
+		entry.firstIndex = uint32_t(part.indices.size());
+		entry.firstVertex = part.nbVertices;
+		entry.nbVertices = mesh.nbVertices();
+		entry.error = lod.error;
+
+		// indices are absolute in the part, so one index buffer serves all the lods
+		auto indices = mesh.indexData(param.nbPointsInFace);
+		for (uint index : indices)
+			part.indices.push_back(index + part.nbVertices);
+		entry.nbIndices = uint32_t(indices.size());
+
+		if (param.floatStreams)
+		{
+			const vec3 zero;
+			const vec2 zeroUV;
+			append(part.streams[MeshFile::POSITION], mesh._vertices.data(), mesh._vertices.size());
+
+			for (uint i = 0; i < mesh.nbVertices(); ++i)
+				append(part.streams[MeshFile::NORMAL], i < mesh._normals.size() ? &mesh._normals[i] : &zero, 1);
+			for (uint i = 0; i < mesh.nbVertices(); ++i)
+				append(part.streams[MeshFile::UV], i < mesh._texCoords.size() ? &mesh._texCoords[i] : &zeroUV, 1);
+		}
+
+		if (param.encoded)
+		{
+			// every lod is in the bounds of the first one, the simplification only removes vertices
+			auto encoded = MeshEncoder::encode(mesh, param.encoding, part.boundsMin, part.boundsMax);
+			append(part.streams[MeshFile::ENCODED], encoded.vertexData.data(), encoded.vertexData.size());
+			part.encodedStride = encoded.stride;
+
+			for (int i = 0; i < 4; ++i)
+			{
+				entry.positionDecode[i] = encoded.positionDecode[i];
+				entry.uvDecode[i] = encoded.uvDecode[i];
+			}
+		}
+
+		part.lods.push_back(entry);
+		part.nbVertices += mesh.nbVertices();
+	}
+
+	_parts.push_back(eastl::move(part));
+}
+
+eastl::vector<byte> MeshFileWriter::serialize() const
+{
+	eastl::vector<byte> out(align(sizeof(FileHeader) + _parts.size() * sizeof(PartHeader)), 0);
+	eastl::vector<PartHeader> headers(_parts.size());
+
+	auto writeStream = [&](const void* data, size_t size) -> uint64_t
+	{
+		out.resize(align(out.size()), 0);
+		uint64_t offset = out.size();
+		append(out, (const byte*)data, size);
+		return offset;
+	};
+
+	for (size_t i = 0; i < _parts.size(); ++i)
+	{
+		const PartData& part = _parts[i];
+		PartHeader& ph = headers[i];
+		memset(&ph, 0, sizeof(ph));
+
+		for (int s = 0; s < MeshFile::NB_STREAMS; ++s)
+		{
+			if (part.streams[s].empty())
+				continue;
+
+			ph.streamOffsets[s] = writeStream(part.streams[s].data(), part.streams[s].size());
+			ph.streamSizes[s] = part.streams[s].size();
+		}
+
+		ph.indexOffset = writeStream(part.indices.data(), part.indices.size() * sizeof(uint));
+		ph.lodOffset = writeStream(part.lods.data(), part.lods.size() * sizeof(MeshFile::Lod));
+
+		ph.nbVertices = part.nbVertices;
+		ph.nbIndices = uint32_t(part.indices.size());
+		ph.nbLods = uint32_t(part.lods.size());
+		ph.nbPointsInFace = part.nbPointsInFace;
+		ph.encodedStride = part.encodedStride;
+		ph.normalEncoding = uint32_t(part.encoding.normals);
+		ph.withUV = part.encoding.withUV ? 1 : 0;
+
+		for (int a = 0; a < 3; ++a)
+		{
+			ph.boundsMin[a] = part.boundsMin[a];
+			ph.boundsMax[a] = part.boundsMax[a];
+			ph.sphere[a] = part.boundingSphere.center()[a];
+		}
+		ph.sphere[3] = part.boundingSphere.radius();
+	}
+
+	out.resize(align(out.size()), 0);
+
+	FileHeader header = {};
+	header.magic = MeshFile::MAGIC;
+	header.version = MeshFile::VERSION;
+	header.nbParts = uint32_t(_parts.size());
+	header.fileSize = out.size();
+	header.partTableOffset = sizeof(FileHeader);
+
+	memcpy(out.data(), &header, sizeof(header));
+	if (!headers.empty())
+		memcpy(out.data() + sizeof(FileHeader), headers.data(), headers.size() * sizeof(PartHeader));
+
+	return out;
+}
+
+bool MeshFileWriter::write(const eastl::string& path) const
+{
+	return write(path, serialize());
+}
+
+bool MeshFileWriter::write(const eastl::string& path, const eastl::vector<byte>& data)
+{
+	createParentDirectory(path);
+
+	// write in a temporary file first, a reader never sees a partial file
+	eastl::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+	ok = fclose(file) == 0 && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+
+	if (!ok)
+		remove(tmpPath.c_str());
+	return ok;
+}
+
+}
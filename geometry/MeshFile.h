@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MeshEncoder.h"
+#include "core/NonCopyable.h"
+
+#include <cstdint>
+
+namespace tim
+{
+	/* Binary container for generated geometry, made to be memory mapped and read without copy:
+	   - a header (magic, version, size) followed by a table of parts
+	   - for each part, the vertex streams (float positions, normals, uvs and/or the encoded vertices of MeshEncoder),
+	     the indices and a lod table, each stream aligned on STREAM_ALIGNMENT bytes
+	   All the lods of a part share the same vertex and index streams, a lod is a range of indices (absolute in the part)
+	   and a range of vertices, so the whole part is uploaded once and each lod is drawn with an index offset. */
+	class MeshFile : NonCopyable
+	{
+	public:
+		static const uint32_t MAGIC = 0x48534D4C; // "LMSH"
+		static const uint32_t VERSION = 1;
+		static const uint STREAM_ALIGNMENT = 64;
+
+		enum Stream { POSITION, NORMAL, UV, ENCODED, NB_STREAMS };
+
+		struct Lod
+		{
+			uint32_t firstIndex, nbIndices;
+			uint32_t firstVertex, nbVertices;
+			float error; // geometric error of the simplification, in mesh units
+			float reserved[3];
+			float positionDecode[4]; // see MeshEncoder::EncodedMesh
+			float uvDecode[4];
+		};
+
+		template<class T>
+		struct View
+		{
+			const T* data = nullptr;
+			size_t size = 0;
+
+			const T* begin() const { return data; }
+			const T* end() const { return data + size; }
+			const T& operator[](size_t i) const { return data[i]; }
+			bool empty() const { return size == 0; }
+		};
+
+		/* Pointers inside the file, valid while the MeshFile is open */
+		struct Part
+		{
+			View<vec3> positions, normals;
+			View<vec2> texCoords;
+			View<byte> encodedVertices;
+			View<uint> indices;
+			View<Lod> lods;
+
+			uint nbVertices = 0;
+			uint nbPointsInFace = 3;
+			uint encodedStride = 0;
+			MeshEncoder::Parameter encoding;
+
+			vec3 boundsMin, boundsMax;
+			Sphere boundingSphere;
+		};
+
+		MeshFile() = default;
+		~MeshFile();
+
+		/* Map the file, false if it doesn't exist or isn't a valid file of this version */
+		bool open(const eastl::string& path);
+
+		/* Use a buffer in memory (from MeshFileWriter::serialize), the MeshFile keeps it */
+		bool open(eastl::vector<byte>&& data);
+
+		void close();
+
+		bool isOpen() const { return _data != nullptr; }
+		uint nbParts() const { return uint(_parts.size()); }
+		const Part& part(uint i) const { return _parts[i]; }
+
+		/* Copy a lod of a part back in a mesh, decoding the vertices if the float streams are not stored */
+		static BaseMesh extractMesh(const Part&, uint lod = 0);
+
+		/* FNV-1a, to build cache keys from the generation parameters */
+		static uint64_t hash(const void*, size_t, uint64_t seed = 14695981039346656037ull);
+
+	private:
+		const byte* _data = nullptr;
+		size_t _size = 0;
+
+		eastl::vector<byte> _memory;
+		void* _mapping = nullptr; // platform handles of the mapped file
+		void* _file = nullptr;
+
+		eastl::vector<Part> _parts;
+
+		bool parse();
+	};
+
+	class MeshFileWriter
+	{
+	public:
+		struct Lod
+		{
+			const BaseMesh* mesh;
+			float error;
+		};
+
+		struct PartParameter
+		{
+			bool floatStreams = false; // positions, normals and uvs as floats, for the cpu side
+			bool encoded = true;
+			MeshEncoder::Parameter encoding;
+			uint nbPointsInFace = 3;
+		};
+
+		/* The lods are stored in the given order, the vertices are quantized in the bounds of the first lod */
+		void addPart(const eastl::vector<Lod>&, const PartParameter&);
+
+		eastl::vector<byte> serialize() const;
+
+		/* Write the file, creating the parent directory if needed */
+		bool write(const eastl::string& path) const;
+		static bool write(const eastl::string& path, const eastl::vector<byte>& data);
+
+	private:
+		struct PartData
+		{
+			eastl::vector<byte> streams[MeshFile::NB_STREAMS];
+			eastl::vector<uint> indices;
+			eastl::vector<MeshFile::Lod> lods;
+
+			uint nbVertices = 0;
+			uint nbPointsInFace = 3;
+			uint encodedStride = 0;
+			MeshEncoder::Parameter encoding;
+			vec3 boundsMin, boundsMax;
+			Sphere boundingSphere;
+		};
+
+		eastl::vector<PartData> _parts;
+	};
+}
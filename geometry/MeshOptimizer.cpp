@@ -0,0 +1,394 @@
+#include "MeshOptimizer.h"
+
+#include <EASTL/sort.h>
+
+namespace tim
+{
+
+namespace
+{
+	const uint NO_VERTEX = ~0u;
+
+	/* Triangles first, in their current order, then everything else */
+	void splitFaces(const eastl::vector<BaseMesh::Face>& faces, eastl::vector<uint>& triangles, eastl::vector<BaseMesh::Face>& others)
+	{
+		triangles.reserve(faces.size() * 3);
+		for (const auto& f : faces)
+		{
+			if (f.nbIndexes == 3)
+				triangles.insert(triangles.end(), f.indexes.begin(), f.indexes.begin() + 3);
+			else
+				others.push_back(f);
+		}
+	}
+
+	void mergeFaces(eastl::vector<BaseMesh::Face>& faces, const eastl::vector<uint>& triangles, const eastl::vector<BaseMesh::Face>& others)
+	{
+		faces.clear();
+		faces.reserve(triangles.size() / 3 + others.size());
+		for (size_t i = 0; i < triangles.size(); i += 3)
+			faces.push_back({ { triangles[i], triangles[i + 1], triangles[i + 2], 0 }, 3 });
+
+		faces.insert(faces.end(), others.begin(), others.end());
+	}
+
+	/* The faces may only index a shared vertex buffer (see Planet), so don't trust nbVertices */
+	uint vertexCount(const eastl::vector<uint>& triangles, uint nbVertices)
+	{
+		for (uint v : triangles)
+			nbVertices = eastl::max(nbVertices, v + 1);
+		return nbVertices;
+	}
+
+	/* FIFO cache simulation, with timestamps instead of a real queue */
+	class VertexCache
+	{
+	public:
+		VertexCache(uint nbVertices, uint size) : _timestamps(nbVertices, 0), _time(size + 1), _size(size) {}
+
+		// return true if v had to be transformed
+		bool access(uint v)
+		{
+			if (_time - _timestamps[v] > _size)
+			{
+				_timestamps[v] = _time++;
+				return true;
+			}
+			return false;
+		}
+
+		uint missesForTriangle(const uint* t) { return uint(access(t[0])) + uint(access(t[1])) + uint(access(t[2])); }
+
+		void flush() { _time += _size + 1; }
+
+	private:
+		eastl::vector<uint> _timestamps;
+		uint _time, _size;
+	};
+
+	void tipsify(eastl::vector<uint>& triangles, uint nbVertices, uint cacheSize)
+	{
+		const uint nbTriangles = uint(triangles.size() / 3);
+
+		// vertex -> triangles
+		eastl::vector<uint> offsets(nbVertices + 1, 0), adjacency(triangles.size());
+		for (uint v : triangles)
+			offsets[v + 1]++;
+		for (uint i = 1; i <= nbVertices; ++i)
+			offsets[i] += offsets[i - 1];
+
+		eastl::vector<uint> liveTriangles(nbVertices);
+		for (uint v = 0; v < nbVertices; ++v)
+			liveTriangles[v] = offsets[v + 1] - offsets[v];
+
+		{
+			eastl::vector<uint> fill(offsets.begin(), offsets.end() - 1);
+			for (uint i = 0; i < triangles.size(); ++i)
+				adjacency[fill[triangles[i]]++] = i / 3;
+		}
+
+		eastl::vector<uint> cacheTime(nbVertices, 0);
+		eastl::vector<bool> emitted(nbTriangles, false);
+		eastl::vector<uint> deadEnd;
+		deadEnd.reserve(triangles.size());
+		eastl::vector<uint> candidates;
+
+		eastl::vector<uint> result;
+		result.reserve(triangles.size());
+
+		uint time = cacheSize + 1;
+		uint cursor = 0;
+		uint fanning = triangles.empty() ? NO_VERTEX : triangles[0];
+
+		while (fanning != NO_VERTEX)
+		{
+			candidates.clear();
+
+			// emit every triangle around the fanning vertex
+			for (uint k = offsets[fanning]; k < offsets[fanning + 1]; ++k)
+			{
+				uint t = adjacency[k];
+				if (emitted[t])
+					continue;
+
+				emitted[t] = true;
+				for (int i = 0; i < 3; ++i)
+				{
+					uint v = triangles[t * 3 + i];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveTriangles[v]--;
+
+					if (time - cacheTime[v] > cacheSize)
+						cacheTime[v] = time++;
+				}
+			}
+
+			// next fanning vertex: the one still in cache with the most remaining triangles which will stay in cache
+			uint best = NO_VERTEX;
+			int bestPriority = -1;
+			for (uint v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+					continue;
+
+				int priority = 0;
+				if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+					priority = int(time - cacheTime[v]);
+
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					best = v;
+				}
+			}
+
+			if (best == NO_VERTEX)
+			{
+				// dead end, go back to a recently used vertex, or to the next vertex in input order
+				while (!deadEnd.empty() && best == NO_VERTEX)
+				{
+					uint v = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[v] > 0)
+						best = v;
+				}
+
+				while (best == NO_VERTEX && cursor < nbVertices)
+				{
+					if (liveTriangles[cursor] > 0)
+						best = cursor;
+					++cursor;
+				}
+			}
+
+			fanning = best;
+		}
+
+		triangles = eastl::move(result);
+	}
+
+	/* Cluster starts: where the cache is flushed (every vertex of a triangle missed),
+	   then clusters are split again each time a sub cluster, starting with an empty cache, reaches threshold * ACMR of the cluster */
+	eastl::vector<uint> generateClusters(const eastl::vector<uint>& triangles, uint nbVertices, float threshold, uint cacheSize)
+	{
+		const uint nbTriangles = uint(triangles.size() / 3);
+
+		eastl::vector<uint> hard;
+		{
+			VertexCache cache(nbVertices, cacheSize);
+			for (uint t = 0; t < nbTriangles; ++t)
+			{
+				if (cache.missesForTriangle(&triangles[t * 3]) == 3 || t == 0)
+					hard.push_back(t);
+			}
+		}
+
+		eastl::vector<uint> clusters;
+		VertexCache cache(nbVertices, cacheSize);
+
+		for (size_t c = 0; c < hard.size(); ++c)
+		{
+			uint begin = hard[c];
+			uint end = c + 1 < hard.size() ? hard[c + 1] : nbTriangles;
+
+			uint clusterMisses = 0;
+			cache.flush();
+			for (uint t = begin; t < end; ++t)
+				clusterMisses += cache.missesForTriangle(&triangles[t * 3]);
+
+			float clusterThreshold = threshold * float(clusterMisses) / float(end - begin);
+
+			clusters.push_back(begin);
+			cache.flush();
+			uint misses = 0, start = begin;
+			for (uint t = begin; t < end; ++t)
+			{
+				misses += cache.missesForTriangle(&triangles[t * 3]);
+
+				// this sub cluster has a good enough cache efficiency, begin a new one
+				if (t + 1 < end && float(misses) / float(t + 1 - start) <= clusterThreshold)
+				{
+					clusters.push_back(t + 1);
+					cache.flush();
+					misses = 0;
+					start = t + 1;
+				}
+			}
+		}
+
+		return clusters;
+	}
+}
+
+MeshOptimizer::CacheStatistics MeshOptimizer::analyzeVertexCache(const BaseMesh& mesh, uint cacheSize)
+{
+	eastl::vector<uint> triangles;
+	eastl::vector<BaseMesh::Face> others;
+	splitFaces(mesh._faces, triangles, others);
+
+	CacheStatistics stats;
+	if (triangles.empty())
+		return stats;
+
+	uint nbVertices = vertexCount(triangles, mesh.nbVertices());
+	VertexCache cache(nbVertices, cacheSize);
+	eastl::vector<bool> used(nbVertices, false);
+	uint nbUsed = 0;
+
+	for (uint v : triangles)
+	{
+		stats.nbTransformedVertices += uint(cache.access(v));
+		if (!used[v])
+		{
+			used[v] = true;
+			++nbUsed;
+		}
+	}
+
+	stats.acmr = float(stats.nbTransformedVertices) / float(triangles.size() / 3);
+	stats.atvr = float(stats.nbTransformedVertices) / float(nbUsed);
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(BaseMesh& mesh, uint cacheSize)
+{
+	eastl::vector<uint> triangles;
+	eastl::vector<BaseMesh::Face> others;
+	splitFaces(mesh._faces, triangles, others);
+
+	if (triangles.empty())
+		return;
+
+	tipsify(triangles, vertexCount(triangles, mesh.nbVertices()), cacheSize);
+	mergeFaces(mesh._faces, triangles, others);
+	mesh._vertexToFaces.clear();
+}
+
+void MeshOptimizer::optimizeOverdraw(BaseMesh& mesh, float threshold, uint cacheSize)
+{
+	eastl::vector<uint> triangles;
+	eastl::vector<BaseMesh::Face> others;
+	splitFaces(mesh._faces, triangles, others);
+
+	// the sort needs the positions
+	if (triangles.empty() || vertexCount(triangles, mesh.nbVertices()) > mesh.nbVertices())
+		return;
+
+	eastl::vector<uint> clusters = generateClusters(triangles, mesh.nbVertices(), threshold, cacheSize);
+	const uint nbTriangles = uint(triangles.size() / 3);
+
+	// area weighted centroid of the mesh and of every cluster, and the cluster average normal
+	struct Cluster
+	{
+		uint begin, end;
+		vec3 centroid, normal;
+		float area;
+		float sortKey;
+	};
+	eastl::vector<Cluster> clusterData(clusters.size());
+
+	vec3 meshCentroid;
+	float meshArea = 0;
+
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		Cluster& cluster = clusterData[c];
+		cluster.begin = clusters[c];
+		cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : nbTriangles;
+		cluster.area = 0;
+
+		for (uint t = cluster.begin; t < cluster.end; ++t)
+		{
+			vec3 p0 = mesh._vertices[triangles[t * 3]], p1 = mesh._vertices[triangles[t * 3 + 1]], p2 = mesh._vertices[triangles[t * 3 + 2]];
+			vec3 normal = (p1 - p0).cross(p2 - p0);
+			float area = normal.length();
+
+			cluster.centroid += (p0 + p1 + p2) * (area / 3);
+			cluster.normal += normal;
+			cluster.area += area;
+		}
+
+		meshCentroid += cluster.centroid;
+		meshArea += cluster.area;
+
+		cluster.centroid = cluster.area > 0 ? cluster.centroid / cluster.area : mesh._vertices[triangles[cluster.begin * 3]];
+	}
+
+	meshCentroid = meshArea > 0 ? meshCentroid / meshArea : vec3();
+
+	for (auto& cluster : clusterData)
+	{
+		float length = cluster.normal.length();
+		cluster.sortKey = length > 0 ? (cluster.centroid - meshCentroid).dot(cluster.normal / length) : 0;
+	}
+
+	// clusters facing outward are the most likely to occlude the others
+	eastl::stable_sort(clusterData.begin(), clusterData.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	eastl::vector<uint> result;
+	result.reserve(triangles.size());
+	for (const auto& cluster : clusterData)
+		result.insert(result.end(), triangles.begin() + cluster.begin * 3, triangles.begin() + cluster.end * 3);
+
+	mergeFaces(mesh._faces, result, others);
+	mesh._vertexToFaces.clear();
+}
+
+void MeshOptimizer::optimizeVertexFetch(BaseMesh& mesh)
+{
+	const uint nbVertices = mesh.nbVertices();
+	eastl::vector<uint> remap(nbVertices, NO_VERTEX);
+	uint next = 0;
+
+	for (auto& f : mesh._faces)
+	{
+		for (int i = 0; i < f.nbIndexes; ++i)
+		{
+			// faces out of the vertex buffer: nothing to reorder
+			if (f.indexes[i] >= nbVertices)
+				return;
+
+			if (remap[f.indexes[i]] == NO_VERTEX)
+				remap[f.indexes[i]] = next++;
+		}
+	}
+
+	// unused vertices are kept at the end
+	for (auto& r : remap)
+	{
+		if (r == NO_VERTEX)
+			r = next++;
+	}
+
+	for (auto& f : mesh._faces)
+	{
+		for (int i = 0; i < f.nbIndexes; ++i)
+			f.indexes[i] = remap[f.indexes[i]];
+	}
+
+	auto reorder = [&](auto& attributes)
+	{
+		if (attributes.size() != nbVertices)
+			return;
+
+		auto copy = attributes;
+		for (uint v = 0; v < nbVertices; ++v)
+			attributes[remap[v]] = copy[v];
+	};
+
+	reorder(mesh._vertices);
+	reorder(mesh._normals);
+	reorder(mesh._texCoords);
+	mesh._vertexToFaces.clear();
+}
+
+void MeshOptimizer::optimize(BaseMesh& mesh, float overdrawThreshold, uint cacheSize)
+{
+	optimizeVertexCache(mesh, cacheSize);
+	optimizeOverdraw(mesh, overdrawThreshold, cacheSize);
+	optimizeVertexFetch(mesh);
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Mesh.h"
+
+namespace tim
+{
+	/* Reorder the faces and the vertices of a mesh for the gpu, to run before MeshBuffers::createFromMesh:
+	   - optimizeVertexCache : Tipsify triangle order for a post transform vertex cache of the given size
+	   - optimizeOverdraw : sort the clusters of the cache optimized order so that outer facing ones are drawn first
+	   - optimizeVertexFetch : vertices stored in the order they are first used
+	   Only the triangles are reordered, other faces keep their order after them. */
+	class MeshOptimizer
+	{
+	public:
+		static const uint DEFAULT_CACHE_SIZE = 16;
+
+		struct CacheStatistics
+		{
+			uint nbTransformedVertices = 0;
+			float acmr = 0; // transformed vertices per triangle, 0.5 is the best case, 3 the worst
+			float atvr = 0; // transformed vertices per used vertex, 1 is the best case
+		};
+
+		MeshOptimizer() = delete;
+
+		/* Simulate a FIFO post transform cache on the triangles of the mesh */
+		static CacheStatistics analyzeVertexCache(const BaseMesh&, uint cacheSize = DEFAULT_CACHE_SIZE);
+
+		static void optimizeVertexCache(BaseMesh&, uint cacheSize = DEFAULT_CACHE_SIZE);
+
+		/* threshold : how much the ACMR can degrade to get smaller clusters, 1.05 is usually a good trade */
+		static void optimizeOverdraw(BaseMesh&, float threshold = 1.05f, uint cacheSize = DEFAULT_CACHE_SIZE);
+
+		static void optimizeVertexFetch(BaseMesh&);
+
+		/* All of the above, in order */
+		static void optimize(BaseMesh&, float overdrawThreshold = 1.05f, uint cacheSize = DEFAULT_CACHE_SIZE);
+	};
+}
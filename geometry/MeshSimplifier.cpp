@@ -0,0 +1,673 @@
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+
+#include <EASTL/sort.h>
+#include <EASTL/unordered_map.h>
+
+namespace tim
+{
+
+namespace
+{
+	const uint MAX_ATTRIBUTES = 5; // normal + uv
+	const float BORDER_WEIGHT = 10.f;
+	const uint NO_VERTEX = ~0u;
+
+	enum VertexKind : byte { MANIFOLD, BORDER, SEAM, LOCKED };
+
+	struct Quadric
+	{
+		// symmetric 3x3 matrix, linear part, constant and total weight
+		float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		float b0 = 0, b1 = 0, b2 = 0, c = 0;
+		float w = 0;
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c; w += q.w;
+			return *this;
+		}
+
+		// weighted squared distance to the plane (gradient,offset) accumulated so far
+		void addPlane(vec3 n, float d, float weight)
+		{
+			a00 += weight * n.x()*n.x(); a11 += weight * n.y()*n.y(); a22 += weight * n.z()*n.z();
+			a01 += weight * n.x()*n.y(); a02 += weight * n.x()*n.z(); a12 += weight * n.y()*n.z();
+			b0 += weight * n.x()*d; b1 += weight * n.y()*d; b2 += weight * n.z()*d;
+			c += weight * d*d;
+		}
+
+		float eval(vec3 p) const
+		{
+			float x = p.x(), y = p.y(), z = p.z();
+			return a00*x*x + a11*y*y + a22*z*z + 2 * (a01*x*y + a02*x*z + a12*y*z) + 2 * (b0*x + b1*y + b2*z) + c;
+		}
+	};
+
+	struct AttributeQuadric
+	{
+		Quadric q; // quadric of the attribute gradients
+		vec4 gradients[MAX_ATTRIBUTES]; // weighted (gradient, offset) of each attribute
+
+		AttributeQuadric& operator+=(const AttributeQuadric& a)
+		{
+			q += a.q;
+			for (uint i = 0; i < MAX_ATTRIBUTES; ++i)
+				gradients[i] += a.gradients[i];
+			return *this;
+		}
+	};
+
+	struct Collapse
+	{
+		uint from, to;
+		float cost; // geometric and attribute error, used to order the collapses
+		float error; // geometric error only, squared
+
+		bool operator<(const Collapse& c) const { return cost < c.cost; }
+	};
+
+	struct HashVec3
+	{
+		size_t operator()(const vec3& v) const { return v.hash<3>(); }
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const eastl::vector<vec3>& positions, const eastl::vector<float>& attributes, uint nbAttributes,
+				   eastl::vector<uint>& triangles, const MeshSimplifier::Parameter& param)
+			: _positions(positions), _attributes(attributes), _nbAttributes(nbAttributes), _triangles(triangles), _param(param)
+		{
+			buildWedges();
+			classifyVertices();
+			buildQuadrics();
+		}
+
+		float run()
+		{
+			float maxError = 0;
+			const float errorLimit = _param.maxError * _param.maxError;
+
+			eastl::vector<Collapse> candidates;
+			eastl::vector<uint> remap(_positions.size());
+			eastl::vector<bool> locked(_positions.size());
+
+			while (true)
+			{
+				uint nbTriangles = uint(_triangles.size() / 3);
+				if (nbTriangles <= _param.targetTriangles || nbTriangles == 0)
+					break;
+
+				buildAdjacency();
+				collectCandidates(candidates);
+
+				if (candidates.empty())
+					break;
+
+				eastl::sort(candidates.begin(), candidates.end());
+
+				for (uint i = 0; i < remap.size(); ++i)
+					remap[i] = i;
+				eastl::fill(locked.begin(), locked.end(), false);
+
+				// each collapse removes up to 2 triangles
+				uint limit = _param.targetTriangles > 0 ? (nbTriangles - _param.targetTriangles) / 2 + 1 : uint(candidates.size());
+				uint nbCollapses = 0;
+
+				for (const Collapse& c : candidates)
+				{
+					if (_param.maxError > 0 && c.error > errorLimit)
+						continue;
+
+					if (locked[_canon[c.from]] || locked[_canon[c.to]])
+						continue;
+
+					bool seam = _kind[c.from] == SEAM;
+					if (hasFlip(c.from, c.to, remap) || (seam && hasFlip(_wedge[c.from], _wedge[c.to], remap)))
+						continue;
+
+					applyCollapse(c.from, c.to, remap, locked);
+					if (seam)
+						applyCollapse(_wedge[c.from], _wedge[c.to], remap, locked);
+
+					_positionQuadrics[_canon[c.to]] += _positionQuadrics[_canon[c.from]];
+					updateBorder(_canon[c.from], _canon[c.to]);
+
+					maxError = eastl::max(maxError, c.error);
+					if (++nbCollapses >= limit)
+						break;
+				}
+
+				if (nbCollapses == 0)
+					break;
+
+				// remap the triangles and drop the degenerated ones
+				size_t writeIndex = 0;
+				for (size_t i = 0; i < _triangles.size(); i += 3)
+				{
+					uint a = remap[_triangles[i]], b = remap[_triangles[i + 1]], c = remap[_triangles[i + 2]];
+					if (a == b || b == c || a == c)
+						continue;
+
+					_triangles[writeIndex++] = a;
+					_triangles[writeIndex++] = b;
+					_triangles[writeIndex++] = c;
+				}
+				_triangles.resize(writeIndex);
+			}
+
+			return sqrtf(maxError);
+		}
+
+	private:
+		const eastl::vector<vec3>& _positions;
+		const eastl::vector<float>& _attributes;
+		uint _nbAttributes;
+		eastl::vector<uint>& _triangles;
+		const MeshSimplifier::Parameter& _param;
+
+		eastl::vector<uint> _canon; // first vertex with the same position
+		eastl::vector<uint> _wedge; // circular list of the vertices with the same position
+		eastl::vector<byte> _kind;
+		eastl::vector<uint> _borderOut, _borderIn; // neighbours along the border, indexed by canonical vertex
+
+		eastl::vector<Quadric> _positionQuadrics; // indexed by canonical vertex
+		eastl::vector<AttributeQuadric> _attributeQuadrics;
+
+		eastl::vector<uint> _adjacencyOffset, _adjacency; // vertex -> triangles
+
+		const float* attributes(uint v) const { return _attributes.data() + size_t(v) * _nbAttributes; }
+
+		void buildWedges()
+		{
+			_canon.resize(_positions.size());
+			_wedge.resize(_positions.size());
+
+			eastl::unordered_map<vec3, uint, HashVec3> positionToVertex;
+			for (uint i = 0; i < _positions.size(); ++i)
+			{
+				auto it = positionToVertex.find(_positions[i]);
+				if (it == positionToVertex.end())
+				{
+					positionToVertex[_positions[i]] = i;
+					_canon[i] = i;
+					_wedge[i] = i;
+				}
+				else
+				{
+					// insert after the canonical vertex in the circular list
+					uint c = it->second;
+					_canon[i] = c;
+					_wedge[i] = _wedge[c];
+					_wedge[c] = i;
+				}
+			}
+		}
+
+		static uint64_t edgeKey(uint a, uint b) { return (uint64_t(a) << 32) | b; }
+
+		bool hasEdge(const eastl::vector<uint64_t>& sortedEdges, uint a, uint b) const
+		{
+			auto it = eastl::lower_bound(sortedEdges.begin(), sortedEdges.end(), edgeKey(a, b));
+			return it != sortedEdges.end() && *it == edgeKey(a, b);
+		}
+
+		void classifyVertices()
+		{
+			const size_t nbVertices = _positions.size();
+
+			// directed edges between positions, an edge without its opposite is a border
+			eastl::vector<uint64_t> edges;
+			edges.reserve(_triangles.size());
+			for (size_t i = 0; i < _triangles.size(); i += 3)
+			{
+				for (int e = 0; e < 3; ++e)
+					edges.push_back(edgeKey(_canon[_triangles[i + e]], _canon[_triangles[i + (e + 1) % 3]]));
+			}
+			eastl::sort(edges.begin(), edges.end());
+
+			_borderOut.assign(nbVertices, NO_VERTEX);
+			_borderIn.assign(nbVertices, NO_VERTEX);
+			eastl::vector<byte> nbBorderOut(nbVertices, 0), nbBorderIn(nbVertices, 0), complex(nbVertices, 0);
+
+			for (size_t i = 0; i < edges.size(); ++i)
+			{
+				uint a = uint(edges[i] >> 32), b = uint(edges[i] & 0xFFFFFFFF);
+
+				// the same directed edge twice is non manifold
+				if ((i > 0 && edges[i - 1] == edges[i]) || (i + 1 < edges.size() && edges[i + 1] == edges[i]))
+					complex[a] = complex[b] = 1;
+
+				if (!hasEdge(edges, b, a))
+				{
+					_borderOut[a] = b;
+					_borderIn[b] = a;
+					nbBorderOut[a] = byte(eastl::min(nbBorderOut[a] + 1, 255));
+					nbBorderIn[b] = byte(eastl::min(nbBorderIn[b] + 1, 255));
+				}
+			}
+
+			_kind.resize(nbVertices);
+			for (uint v = 0; v < nbVertices; ++v)
+			{
+				uint c = _canon[v];
+				uint nbWedges = 1;
+				for (uint w = _wedge[v]; w != v; w = _wedge[w])
+					++nbWedges;
+
+				bool border = nbBorderOut[c] > 0 || nbBorderIn[c] > 0;
+
+				if (complex[c] || nbWedges > 2)
+					_kind[v] = LOCKED;
+				else if (border)
+					_kind[v] = (nbWedges == 1 && nbBorderOut[c] == 1 && nbBorderIn[c] == 1 && !_param.lockBorder) ? BORDER : LOCKED;
+				else if (nbWedges == 2)
+					_kind[v] = SEAM;
+				else
+					_kind[v] = MANIFOLD;
+			}
+
+			// a seam only collapses both sides at once, so both wedges must be seams
+			for (uint v = 0; v < nbVertices; ++v)
+			{
+				if (_kind[v] == SEAM && _kind[_wedge[v]] != SEAM)
+					_kind[v] = LOCKED;
+			}
+
+			buildBorderQuadrics(edges);
+		}
+
+		void buildBorderQuadrics(const eastl::vector<uint64_t>& edges)
+		{
+			_positionQuadrics.assign(_positions.size(), Quadric());
+
+			// keep the border in place with planes orthogonal to the faces along the border
+			for (size_t i = 0; i < _triangles.size(); i += 3)
+			{
+				vec3 p[3] = { _positions[_triangles[i]], _positions[_triangles[i + 1]], _positions[_triangles[i + 2]] };
+				vec3 normal = (p[1] - p[0]).cross(p[2] - p[0]);
+				if (normal.length2() == 0)
+					continue;
+				normal.normalize();
+
+				for (int e = 0; e < 3; ++e)
+				{
+					uint a = _canon[_triangles[i + e]], b = _canon[_triangles[i + (e + 1) % 3]];
+					if (hasEdge(edges, b, a))
+						continue;
+
+					vec3 edge = p[(e + 1) % 3] - p[e];
+					float length2 = edge.length2();
+					vec3 borderNormal = edge.cross(normal);
+					if (length2 == 0 || borderNormal.length2() == 0)
+						continue;
+
+					borderNormal.normalize();
+					float d = -borderNormal.dot(p[e]);
+
+					_positionQuadrics[a].addPlane(borderNormal, d, length2 * BORDER_WEIGHT);
+					_positionQuadrics[b].addPlane(borderNormal, d, length2 * BORDER_WEIGHT);
+				}
+			}
+		}
+
+		void buildQuadrics()
+		{
+			_attributeQuadrics.assign(_nbAttributes > 0 ? _positions.size() : 0, AttributeQuadric());
+
+			for (size_t i = 0; i < _triangles.size(); i += 3)
+			{
+				uint v[3] = { _triangles[i], _triangles[i + 1], _triangles[i + 2] };
+				vec3 p0 = _positions[v[0]], p10 = _positions[v[1]] - p0, p20 = _positions[v[2]] - p0;
+
+				vec3 normal = p10.cross(p20);
+				float area = normal.length() * 0.5f;
+				if (area == 0)
+					continue;
+				normal.normalize();
+
+				Quadric q;
+				q.addPlane(normal, -normal.dot(p0), area);
+				q.w = area;
+
+				for (int k = 0; k < 3; ++k)
+					_positionQuadrics[_canon[v[k]]] += q;
+
+				if (_nbAttributes == 0)
+					continue;
+
+				// gradient of each attribute along the triangle plane: g.p + gw interpolates the attribute
+				float d00 = p10.dot(p10), d01 = p10.dot(p20), d11 = p20.dot(p20);
+				float denom = d00 * d11 - d01 * d01;
+				float invDenom = denom != 0 ? 1.f / denom : 0;
+
+				vec3 g1 = (p10 * d11 - p20 * d01) * invDenom;
+				vec3 g2 = (p20 * d00 - p10 * d01) * invDenom;
+
+				AttributeQuadric aq;
+				aq.q.w = area;
+
+				const float* a0 = attributes(v[0]);
+				const float* a1 = attributes(v[1]);
+				const float* a2 = attributes(v[2]);
+
+				for (uint k = 0; k < _nbAttributes; ++k)
+				{
+					vec3 g = g1 * (a1[k] - a0[k]) + g2 * (a2[k] - a0[k]);
+					float gw = a0[k] - g.dot(p0);
+
+					aq.q.a00 += area * g.x()*g.x(); aq.q.a11 += area * g.y()*g.y(); aq.q.a22 += area * g.z()*g.z();
+					aq.q.a01 += area * g.x()*g.y(); aq.q.a02 += area * g.x()*g.z(); aq.q.a12 += area * g.y()*g.z();
+					aq.q.b0 += area * g.x()*gw; aq.q.b1 += area * g.y()*gw; aq.q.b2 += area * g.z()*gw;
+					aq.q.c += area * gw*gw;
+
+					aq.gradients[k] = vec4(g.x()*area, g.y()*area, g.z()*area, gw*area);
+				}
+
+				for (int k = 0; k < 3; ++k)
+					_attributeQuadrics[v[k]] += aq;
+			}
+		}
+
+		void buildAdjacency()
+		{
+			_adjacencyOffset.assign(_positions.size() + 1, 0);
+			for (uint v : _triangles)
+				_adjacencyOffset[v + 1]++;
+
+			for (size_t i = 1; i < _adjacencyOffset.size(); ++i)
+				_adjacencyOffset[i] += _adjacencyOffset[i - 1];
+
+			_adjacency.resize(_triangles.size());
+			eastl::vector<uint> fill(_adjacencyOffset.begin(), _adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < _triangles.size(); ++i)
+				_adjacency[fill[_triangles[i]]++] = uint(i / 3);
+		}
+
+		bool areAdjacent(uint a, uint b) const
+		{
+			for (uint k = _adjacencyOffset[a]; k < _adjacencyOffset[a + 1]; ++k)
+			{
+				const uint* t = &_triangles[_adjacency[k] * 3];
+				if (t[0] == b || t[1] == b || t[2] == b)
+					return true;
+			}
+			return false;
+		}
+
+		bool canCollapse(uint from, uint to) const
+		{
+			if (_canon[from] == _canon[to])
+				return false;
+
+			switch (_kind[from])
+			{
+			case MANIFOLD:
+				return true;
+
+			case BORDER: // slide along the border only
+				return _canon[to] == _borderOut[_canon[from]] || _canon[to] == _borderIn[_canon[from]];
+
+			case SEAM: // both sides collapse along the seam
+				return _kind[to] == SEAM && areAdjacent(_wedge[from], _wedge[to]);
+
+			default:
+				return false;
+			}
+		}
+
+		float attributeError(uint from, uint to) const
+		{
+			const AttributeQuadric& aq = _attributeQuadrics[from];
+			if (aq.q.w == 0)
+				return 0;
+
+			vec3 p = _positions[to];
+			const float* a = attributes(to);
+
+			float r = aq.q.eval(p);
+			for (uint k = 0; k < _nbAttributes; ++k)
+			{
+				const vec4& g = aq.gradients[k];
+				r += -2 * a[k] * (g.x()*p.x() + g.y()*p.y() + g.z()*p.z() + g.w()) + a[k] * a[k] * aq.q.w;
+			}
+
+			return fabsf(r) / aq.q.w;
+		}
+
+		float collapseCost(uint from, uint to, float& error) const
+		{
+			const Quadric& q = _positionQuadrics[_canon[from]];
+			error = q.w > 0 ? fabsf(q.eval(_positions[to])) / q.w : 0;
+			float cost = error;
+
+			if (_nbAttributes > 0)
+			{
+				cost += attributeError(from, to);
+				if (_kind[from] == SEAM)
+					cost += attributeError(_wedge[from], _wedge[to]);
+			}
+
+			return cost;
+		}
+
+		void collectCandidates(eastl::vector<Collapse>& candidates) const
+		{
+			candidates.clear();
+			for (size_t i = 0; i < _triangles.size(); i += 3)
+			{
+				for (int e = 0; e < 3; ++e)
+				{
+					uint a = _triangles[i + e], b = _triangles[i + (e + 1) % 3];
+
+					// every edge is seen from its two faces, only keep one
+					if (a > b && _kind[a] != BORDER && _kind[b] != BORDER)
+						continue;
+
+					bool ab = canCollapse(a, b), ba = canCollapse(b, a);
+					if (!ab && !ba)
+						continue;
+
+					float errorAB = 0, errorBA = 0;
+					float costAB = ab ? collapseCost(a, b, errorAB) : 0;
+					float costBA = ba ? collapseCost(b, a, errorBA) : 0;
+
+					if (ab && (!ba || costAB <= costBA))
+						candidates.push_back({ a, b, costAB, errorAB });
+					else
+						candidates.push_back({ b, a, costBA, errorBA });
+				}
+			}
+		}
+
+		bool hasFlip(uint from, uint to, const eastl::vector<uint>& remap) const
+		{
+			vec3 pFrom = _positions[from], pTo = _positions[to];
+
+			for (uint k = _adjacencyOffset[from]; k < _adjacencyOffset[from + 1]; ++k)
+			{
+				const uint* t = &_triangles[_adjacency[k] * 3];
+				int slot = t[0] == from ? 0 : (t[1] == from ? 1 : 2);
+
+				uint o1 = remap[t[(slot + 1) % 3]], o2 = remap[t[(slot + 2) % 3]];
+				vec3 p1 = _positions[o1], p2 = _positions[o2];
+
+				// this triangle disappears with the collapse
+				if (o1 == to || o2 == to || p1 == pTo || p2 == pTo)
+					continue;
+
+				vec3 n0 = (p1 - pFrom).cross(p2 - pFrom);
+				vec3 n1 = (p1 - pTo).cross(p2 - pTo);
+
+				if (n0.dot(n1) <= 0.25f * sqrtf(n0.length2() * n1.length2()))
+					return true;
+			}
+
+			return false;
+		}
+
+		void applyCollapse(uint from, uint to, eastl::vector<uint>& remap, eastl::vector<bool>& locked)
+		{
+			remap[from] = to;
+
+			if (_nbAttributes > 0)
+				_attributeQuadrics[to] += _attributeQuadrics[from];
+
+			// the one ring can't move anymore during this pass, the flip tests would be wrong
+			for (uint k = _adjacencyOffset[from]; k < _adjacencyOffset[from + 1]; ++k)
+			{
+				const uint* t = &_triangles[_adjacency[k] * 3];
+				locked[_canon[t[0]]] = locked[_canon[t[1]]] = locked[_canon[t[2]]] = true;
+			}
+			locked[_canon[to]] = true;
+		}
+
+		void updateBorder(uint from, uint to)
+		{
+			if (_kind[from] != BORDER)
+				return;
+
+			if (_borderOut[from] == to)
+			{
+				uint prev = _borderIn[from];
+				_borderOut[prev] = to;
+				_borderIn[to] = prev;
+			}
+			else if (_borderIn[from] == to)
+			{
+				uint next = _borderOut[from];
+				_borderIn[next] = to;
+				_borderOut[to] = next;
+			}
+		}
+	};
+
+	eastl::vector<uint> triangulate(const eastl::vector<BaseMesh::Face>& faces)
+	{
+		eastl::vector<uint> triangles;
+		triangles.reserve(faces.size() * 3);
+
+		for (const auto& f : faces)
+		{
+			if (f.nbIndexes < 3)
+				continue;
+
+			triangles.insert(triangles.end(), { f.indexes[0], f.indexes[1], f.indexes[2] });
+			if (f.nbIndexes == 4)
+				triangles.insert(triangles.end(), { f.indexes[0], f.indexes[2], f.indexes[3] });
+		}
+
+		return triangles;
+	}
+}
+
+BaseMesh MeshSimplifier::simplify(const BaseMesh& mesh, const Parameter& param, float* resultError)
+{
+	const bool withNormals = mesh._normals.size() == mesh._vertices.size();
+	const bool withUVs = mesh._texCoords.size() == mesh._vertices.size();
+	const uint nbAttributes = (withNormals ? 3 : 0) + (withUVs ? 2 : 0);
+
+	eastl::vector<float> attributes(mesh._vertices.size() * nbAttributes);
+	for (size_t i = 0; i < mesh._vertices.size(); ++i)
+	{
+		float* a = attributes.data() + i * nbAttributes;
+		if (withNormals)
+		{
+			for (int k = 0; k < 3; ++k)
+				*a++ = mesh._normals[i][k] * param.normalWeight;
+		}
+		if (withUVs)
+		{
+			for (int k = 0; k < 2; ++k)
+				*a++ = mesh._texCoords[i][k] * param.uvWeight;
+		}
+	}
+
+	eastl::vector<uint> triangles = triangulate(mesh._faces);
+
+	float error = 0;
+	if (triangles.size() / 3 > param.targetTriangles)
+	{
+		Simplifier simplifier(mesh._vertices, attributes, nbAttributes, triangles, param);
+		error = simplifier.run();
+	}
+
+	if (resultError)
+		*resultError = error;
+
+	// compact the vertices still in use
+	BaseMesh result;
+	eastl::vector<uint> newIndex(mesh._vertices.size(), NO_VERTEX);
+
+	result._faces.reserve(triangles.size() / 3);
+	for (size_t i = 0; i < triangles.size(); i += 3)
+	{
+		BaseMesh::Face face = { { 0,0,0,0 }, 3 };
+		for (int k = 0; k < 3; ++k)
+		{
+			uint v = triangles[i + k];
+			if (newIndex[v] == NO_VERTEX)
+			{
+				newIndex[v] = result.nbVertices();
+				result._vertices.push_back(mesh._vertices[v]);
+				if (withNormals) result._normals.push_back(mesh._normals[v]);
+				if (withUVs) result._texCoords.push_back(mesh._texCoords[v]);
+			}
+			face.indexes[k] = newIndex[v];
+		}
+		result._faces.push_back(face);
+	}
+
+	return result;
+}
+
+eastl::vector<MeshSimplifier::Lod> MeshSimplifier::generateLods(const BaseMesh& mesh, const eastl::vector<float>& triangleRatios, const Parameter& param)
+{
+	eastl::vector<Lod> lods;
+	lods.reserve(triangleRatios.size());
+
+	uint nbTriangles = 0;
+	for (const auto& f : mesh._faces)
+		nbTriangles += f.nbIndexes == 4 ? 2 : (f.nbIndexes == 3 ? 1 : 0);
+
+	for (float ratio : triangleRatios)
+	{
+		const BaseMesh& previous = lods.empty() ? mesh : lods.back().mesh;
+		float previousError = lods.empty() ? 0 : lods.back().error;
+
+		if (ratio >= 1)
+		{
+			lods.push_back({ previous, previousError });
+			continue;
+		}
+
+		Parameter lodParam = param;
+		lodParam.targetTriangles = uint(float(nbTriangles) * ratio);
+
+		float error = 0;
+		BaseMesh simplified = simplify(previous, lodParam, &error);
+
+		// errors of successive lods stack up
+		lods.push_back({ eastl::move(simplified), previousError + error });
+	}
+
+	return lods;
+}
+
+eastl::vector<eastl::vector<MeshSimplifier::Lod>> MeshSimplifier::generateLods(const eastl::vector<const BaseMesh*>& meshs,
+																				const eastl::vector<float>& triangleRatios, const Parameter& param)
+{
+	eastl::vector<eastl::vector<Lod>> result(meshs.size());
+	parallelFor(uint(meshs.size()), [&](uint i)
+	{
+		result[i] = generateLods(*meshs[i], triangleRatios, param);
+	});
+
+	return result;
+}
+
+}
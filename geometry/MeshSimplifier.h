@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Mesh.h"
+#include <EASTL/vector.h>
+
+namespace tim
+{
+	/* Quadric error metric simplifier working with half edge collapses:
+	   a vertex is always collapsed onto one of its neighbours, so normals and uvs are kept exact.
+	   The quadrics include the normals and uvs so collapses across attribute variations are penalized.
+	   Seams (vertices sharing a position with different attributes) only collapse along the seam, both sides at once,
+	   borders only slide along the border (or are fully locked). Only triangles are kept in the output. */
+	class MeshSimplifier
+	{
+	public:
+		struct Parameter
+		{
+			uint targetTriangles = 0; // stop once the mesh has this many triangles or less
+			float maxError = 0; // stop before a collapse deviates more than this (in mesh units), 0 = no bound
+
+			float normalWeight = 0.5f;
+			float uvWeight = 0.1f;
+			bool lockBorder = false; // if false border vertices can still slide along the border
+		};
+
+		struct Lod
+		{
+			BaseMesh mesh;
+			float error; // deviation from the original mesh, in mesh units
+		};
+
+		MeshSimplifier() = delete;
+
+		static BaseMesh simplify(const BaseMesh&, const Parameter&, float* resultError = nullptr);
+
+		/* Lod chain where lod i keeps triangleRatios[i] of the original triangles, each lod is simplified from the previous one.
+		   A ratio of 1 gives back the original mesh. */
+		static eastl::vector<Lod> generateLods(const BaseMesh&, const eastl::vector<float>& triangleRatios, const Parameter&);
+
+		/* Same as above for independent meshes, processed in parallel on the thread pool */
+		static eastl::vector<eastl::vector<Lod>> generateLods(const eastl::vector<const BaseMesh*>&, const eastl::vector<float>& triangleRatios,
+															   const Parameter&);
+	};
+}
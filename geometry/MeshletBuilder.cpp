@@ -0,0 +1,402 @@
+#include "MeshletBuilder.h"
+#include "math/BoundingVolume.h"
+
+namespace tim
+{
+
+namespace
+{
+	/* Triangle centroids in a uniform grid, to find the nearest free triangle when a cluster has no free neighbour left */
+	class TriangleGrid
+	{
+	public:
+		TriangleGrid(const eastl::vector<vec3>& centroids) : _centroids(centroids)
+		{
+			const uint nbTriangles = uint(centroids.size());
+
+			_min = vec3::construct(std::numeric_limits<float>::max());
+			vec3 maxB = -_min;
+			for (const vec3& c : centroids)
+			{
+				for (int a = 0; a < 3; ++a) _min[a] = eastl::min(_min[a], c[a]);
+				for (int a = 0; a < 3; ++a) maxB[a] = eastl::max(maxB[a], c[a]);
+			}
+
+			// about 8 triangles per cell
+			uint dim = uint(cbrtf(float(nbTriangles) / 8));
+			dim = eastl::max(1u, eastl::min(dim, 128u));
+
+			for (int a = 0; a < 3; ++a)
+			{
+				_dim[a] = dim;
+				float extent = maxB[a] - _min[a];
+				_cellSize[a] = extent > 0 ? extent / dim : 1;
+			}
+
+			_cells.resize(dim * dim * dim);
+			_triangleCell.resize(nbTriangles);
+			_trianglePos.resize(nbTriangles);
+
+			for (uint t = 0; t < nbTriangles; ++t)
+			{
+				uint cell = cellIndex(cellOf(centroids[t]));
+				_triangleCell[t] = cell;
+				_trianglePos[t] = uint(_cells[cell].size());
+				_cells[cell].push_back(t);
+			}
+		}
+
+		void remove(uint t)
+		{
+			auto& cell = _cells[_triangleCell[t]];
+			uint pos = _trianglePos[t];
+			cell[pos] = cell.back();
+			_trianglePos[cell[pos]] = pos;
+			cell.pop_back();
+		}
+
+		/* -1 if the grid is empty */
+		int nearest(vec3 p) const
+		{
+			ivec3 c = cellOf(p);
+			int best = -1;
+			float bestDist = std::numeric_limits<float>::max();
+			float minCellSize = eastl::min(_cellSize[0], eastl::min(_cellSize[1], _cellSize[2]));
+			int maxRing = int(eastl::max(_dim[0], eastl::max(_dim[1], _dim[2])));
+
+			for (int ring = 0; ring <= maxRing; ++ring)
+			{
+				// the cells of the next rings are all farther than this
+				float ringDist = (ring - 1) * minCellSize;
+				if (best >= 0 && ringDist > 0 && ringDist * ringDist > bestDist)
+					break;
+
+				for (int x = c.x() - ring; x <= c.x() + ring; ++x)
+				for (int y = c.y() - ring; y <= c.y() + ring; ++y)
+				for (int z = c.z() - ring; z <= c.z() + ring; ++z)
+				{
+					if (abs(x - c.x()) != ring && abs(y - c.y()) != ring && abs(z - c.z()) != ring)
+						continue;
+					if (x < 0 || y < 0 || z < 0 || x >= int(_dim[0]) || y >= int(_dim[1]) || z >= int(_dim[2]))
+						continue;
+
+					for (uint t : _cells[cellIndex({ x, y, z })])
+					{
+						float d = (_centroids[t] - p).length2();
+						if (d < bestDist)
+						{
+							bestDist = d;
+							best = int(t);
+						}
+					}
+				}
+			}
+
+			return best;
+		}
+
+	private:
+		const eastl::vector<vec3>& _centroids;
+		vec3 _min, _cellSize;
+		uint _dim[3];
+
+		eastl::vector<eastl::vector<uint>> _cells;
+		eastl::vector<uint> _triangleCell, _trianglePos;
+
+		ivec3 cellOf(vec3 p) const
+		{
+			ivec3 c;
+			for (int a = 0; a < 3; ++a)
+				c[a] = eastl::max(0, eastl::min(int((p[a] - _min[a]) / _cellSize[a]), int(_dim[a]) - 1));
+			return c;
+		}
+
+		uint cellIndex(ivec3 c) const { return (uint(c.x()) * _dim[1] + uint(c.y())) * _dim[2] + uint(c.z()); }
+	};
+
+	/* Triangle normal, with the orientation used by BaseMesh::computeNormals */
+	vec3 triangleNormal(vec3 p0, vec3 p1, vec3 p2)
+	{
+		return (p2 - p1).cross(p0 - p1);
+	}
+}
+
+eastl::vector<uint> MeshletBuilder::Meshlets::indexData() const
+{
+	eastl::vector<uint> indices;
+	indices.reserve(triangles.size());
+
+	for (const Meshlet& m : meshlets)
+	{
+		for (uint i = 0; i < m.nbTriangles * 3; ++i)
+			indices.push_back(vertices[m.firstVertex + triangles[(m.firstTriangle * 3) + i]]);
+	}
+
+	return indices;
+}
+
+MeshletBuilder::Meshlets MeshletBuilder::build(const BaseMesh& mesh, uint maxVertices, uint maxTriangles)
+{
+	Meshlets result;
+
+	maxVertices = eastl::max(3u, eastl::min(maxVertices, 256u));
+	maxTriangles = eastl::max(1u, maxTriangles);
+
+	// triangles only, quads are split
+	eastl::vector<uint> tris;
+	tris.reserve(mesh._faces.size() * 3);
+	for (const auto& f : mesh._faces)
+	{
+		if (f.nbIndexes == 3 || f.nbIndexes == 4)
+			tris.insert(tris.end(), { f.indexes[0], f.indexes[1], f.indexes[2] });
+		if (f.nbIndexes == 4)
+			tris.insert(tris.end(), { f.indexes[0], f.indexes[2], f.indexes[3] });
+	}
+
+	const uint nbTriangles = uint(tris.size() / 3);
+	const uint nbVertices = mesh.nbVertices();
+	if (nbTriangles == 0)
+		return result;
+
+	// vertex to triangles
+	eastl::vector<uint> adjOffset(nbVertices + 1, 0), adjacency(tris.size());
+	for (uint v : tris)
+		++adjOffset[v + 1];
+	for (uint v = 0; v < nbVertices; ++v)
+		adjOffset[v + 1] += adjOffset[v];
+
+	{
+		eastl::vector<uint> fill(adjOffset.begin(), adjOffset.end() - 1);
+		for (uint t = 0; t < nbTriangles; ++t)
+			for (int k = 0; k < 3; ++k)
+				adjacency[fill[tris[t * 3 + k]]++] = t;
+	}
+
+	eastl::vector<vec3> centroids(nbTriangles);
+	for (uint t = 0; t < nbTriangles; ++t)
+		centroids[t] = (mesh._vertices[tris[t * 3]] + mesh._vertices[tris[t * 3 + 1]] + mesh._vertices[tris[t * 3 + 2]]) / 3;
+
+	TriangleGrid grid(centroids);
+
+	eastl::vector<bool> used(nbTriangles, false);
+	eastl::vector<int> localIndex(nbVertices, -1);
+	uint cursor = 0; // first triangle which may be free, in the order of the mesh
+
+	Meshlet current = { 0, 0, 0, 0 };
+	vec3 centroidSum;
+
+	auto flush = [&]()
+	{
+		if (current.nbTriangles == 0)
+			return;
+
+		for (uint i = 0; i < current.nbVertices; ++i)
+			localIndex[result.vertices[current.firstVertex + i]] = -1;
+
+		result.meshlets.push_back(current);
+		current = { uint(result.vertices.size()), 0, uint(result.triangles.size() / 3), 0 };
+		centroidSum = vec3();
+	};
+
+	auto newVertices = [&](uint t)
+	{
+		uint n = 0;
+		for (int k = 0; k < 3; ++k)
+			n += localIndex[tris[t * 3 + k]] < 0 ? 1 : 0;
+		return n;
+	};
+
+	for (uint emitted = 0; emitted < nbTriangles; ++emitted)
+	{
+		int best = -1;
+		uint bestNew = 4;
+		float bestDist = std::numeric_limits<float>::max();
+
+		if (current.nbTriangles > 0)
+		{
+			const vec3 center = centroidSum / float(current.nbTriangles);
+
+			// the free neighbours of the cluster, the ones adding the fewest vertices then the closest
+			for (uint i = 0; i < current.nbVertices; ++i)
+			{
+				uint v = result.vertices[current.firstVertex + i];
+				for (uint a = adjOffset[v]; a < adjOffset[v + 1]; ++a)
+				{
+					uint t = adjacency[a];
+					if (used[t])
+						continue;
+
+					uint n = newVertices(t);
+					float d = (centroids[t] - center).length2();
+					if (n < bestNew || (n == bestNew && d < bestDist))
+					{
+						best = int(t);
+						bestNew = n;
+						bestDist = d;
+					}
+				}
+			}
+
+			if (best < 0)
+				best = grid.nearest(center);
+		}
+		else
+		{
+			while (used[cursor])
+				++cursor;
+			best = int(cursor);
+		}
+
+		const uint t = uint(best);
+		if (current.nbVertices + newVertices(t) > maxVertices || current.nbTriangles + 1 > maxTriangles)
+			flush();
+
+		for (int k = 0; k < 3; ++k)
+		{
+			uint v = tris[t * 3 + k];
+			if (localIndex[v] < 0)
+			{
+				localIndex[v] = int(current.nbVertices++);
+				result.vertices.push_back(v);
+			}
+			result.triangles.push_back(uint8_t(localIndex[v]));
+		}
+
+		++current.nbTriangles;
+		centroidSum += centroids[t];
+		used[t] = true;
+		grid.remove(t);
+	}
+
+	flush();
+
+	result.bounds.reserve(result.meshlets.size());
+	for (const Meshlet& m : result.meshlets)
+		result.bounds.push_back(computeBounds(mesh, result, m));
+
+	return result;
+}
+
+MeshletBuilder::Bounds MeshletBuilder::computeBounds(const BaseMesh& mesh, const Meshlets& meshlets, const Meshlet& m)
+{
+	Bounds bounds;
+	if (m.nbVertices == 0)
+		return bounds;
+
+	eastl::vector<vec3> clusterPoints(m.nbVertices);
+	for (uint i = 0; i < m.nbVertices; ++i)
+		clusterPoints[i] = mesh._vertices[meshlets.vertices[m.firstVertex + i]];
+
+	const float* data = reinterpret_cast<const float*>(clusterPoints.data());
+	BoundingVolume::Box box = BoundingVolume::computeBox(data, m.nbVertices);
+	bounds.boxMin = box.min;
+	bounds.boxMax = box.max;
+	bounds.sphere = BoundingVolume::minimalSphere(data, m.nbVertices);
+
+	const vec3 center = bounds.sphere.center();
+
+	// normal cone, from the unit normals of the non degenerated triangles
+	eastl::vector<vec3> normals;
+	eastl::vector<vec3> points;
+	vec3 axis;
+
+	for (uint i = 0; i < m.nbTriangles; ++i)
+	{
+		const uint8_t* tri = &meshlets.triangles[(m.firstTriangle + i) * 3];
+		vec3 p0 = mesh._vertices[meshlets.vertices[m.firstVertex + tri[0]]];
+		vec3 p1 = mesh._vertices[meshlets.vertices[m.firstVertex + tri[1]]];
+		vec3 p2 = mesh._vertices[meshlets.vertices[m.firstVertex + tri[2]]];
+
+		vec3 n = triangleNormal(p0, p1, p2);
+		float l = n.length();
+		if (l == 0)
+			continue;
+
+		normals.push_back(n / l);
+		points.push_back(p0);
+		axis += n / l;
+	}
+
+	bounds.coneApex = center;
+	bounds.coneCutoff = 1;
+
+	float axisLength = axis.length();
+	if (normals.empty() || axisLength == 0)
+		return bounds;
+
+	axis /= axisLength;
+	bounds.coneAxis = axis;
+
+	float minDot = 1;
+	for (const vec3& n : normals)
+		minDot = eastl::min(minDot, n.dot(axis));
+
+	// too spread, the cluster can't be seen from behind by all the points of a half space
+	if (minDot <= 0.1f)
+		return bounds;
+
+	// the apex is the point of the axis behind every triangle plane
+	float maxT = 0;
+	for (size_t i = 0; i < normals.size(); ++i)
+	{
+		float dc = (center - points[i]).dot(normals[i]);
+		float dn = axis.dot(normals[i]);
+		maxT = eastl::max(maxT, dc / dn);
+	}
+
+	bounds.coneApex = center - axis * maxT;
+	bounds.coneCutoff = sqrtf(1 - minDot * minDot);
+	return bounds;
+}
+
+void MeshletBuilder::cull(const Meshlets& meshlets, const CullParameter& param, eastl::vector<uint>& visible)
+{
+	const mat3 rotScale = param.transform.to<3>();
+	float scale = 0;
+	for (int a = 0; a < 3; ++a)
+		scale = eastl::max(scale, vec3(rotScale[0][a], rotScale[1][a], rotScale[2][a]).length());
+
+	for (uint i = 0; i < meshlets.bounds.size(); ++i)
+	{
+		const Bounds& b = meshlets.bounds[i];
+		const vec3 center = param.transform * b.sphere.center();
+		const float radius = b.sphere.radius() * scale;
+
+		if ((center - param.cameraPos).length() - radius > param.maxDistance)
+			continue;
+
+		if (param.frustum.collide(Sphere(center, radius)) == Frustum::OUTSIDE)
+			continue;
+
+		if (param.backface && b.coneCutoff < 1)
+		{
+			vec3 apex = param.transform * b.coneApex;
+			vec3 axis = (rotScale * b.coneAxis).normalized();
+			vec3 toApex = apex - param.cameraPos;
+			float l = toApex.length();
+
+			if (l > 0 && toApex.dot(axis) >= b.coneCutoff * l)
+				continue;
+		}
+
+		visible.push_back(i);
+	}
+}
+
+eastl::vector<MeshletBuilder::DrawRange> MeshletBuilder::drawRanges(const Meshlets& meshlets, const eastl::vector<uint>& visible)
+{
+	eastl::vector<DrawRange> ranges;
+
+	for (uint index : visible)
+	{
+		const Meshlet& m = meshlets.meshlets[index];
+		if (!ranges.empty() && ranges.back().firstIndex + ranges.back().nbIndices == m.firstTriangle * 3)
+			ranges.back().nbIndices += m.nbTriangles * 3;
+		else
+			ranges.push_back({ m.firstTriangle * 3, m.nbTriangles * 3 });
+	}
+
+	return ranges;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Mesh.h"
+#include "math/Frustum.h"
+
+#include <cstdint>
+
+namespace tim
+{
+	/* Split the triangles of a mesh in clusters of at most maxVertices vertices and maxTriangles triangles.
+	   A cluster grows with the adjacent triangles sharing the most vertices with it, then with the nearest free triangle,
+	   so the clusters stay compact and their bounds tight. Each cluster has a bounding sphere, a box and a normal cone.
+	   The index buffer of indexData() stores the clusters one after the other, a cluster is drawn with an index range. */
+	class MeshletBuilder
+	{
+	public:
+		static const uint DEFAULT_MAX_VERTICES = 64;
+		static const uint DEFAULT_MAX_TRIANGLES = 124;
+
+		struct Meshlet
+		{
+			uint firstVertex, nbVertices; // in Meshlets::vertices
+			uint firstTriangle, nbTriangles; // in Meshlets::triangles, 3 local indices per triangle
+		};
+
+		struct Bounds
+		{
+			Sphere sphere;
+			vec3 boxMin, boxMax;
+
+			/* The cluster is backfacing for every point p with dot(normalize(coneApex - p), coneAxis) >= coneCutoff,
+			   coneCutoff is 1 when the normals are too spread to cull the cluster */
+			vec3 coneApex, coneAxis;
+			float coneCutoff = 1;
+		};
+
+		struct Meshlets
+		{
+			eastl::vector<Meshlet> meshlets;
+			eastl::vector<Bounds> bounds;
+			eastl::vector<uint> vertices; // index of the vertex in the mesh
+			eastl::vector<uint8_t> triangles;
+
+			/* Indices in the mesh, cluster after cluster : the cluster i is the range [firstTriangle*3, (firstTriangle+nbTriangles)*3) */
+			eastl::vector<uint> indexData() const;
+		};
+
+		struct CullParameter
+		{
+			Frustum frustum;
+			vec3 cameraPos;
+			float maxDistance = (std::numeric_limits<float>::max)(); // parenthesized against the max macros of Windows.h and WorleyNoise.h
+			bool backface = true;
+
+			/* Local to world, rotation, translation and uniform scale only */
+			mat4 transform = mat4::IDENTITY();
+		};
+
+		/* A draw call: a range of the index buffer of indexData() */
+		struct DrawRange
+		{
+			uint firstIndex, nbIndices;
+		};
+
+		MeshletBuilder() = delete;
+
+		/* Only the triangles are used, quads are split. maxVertices must not exceed 256 */
+		static Meshlets build(const BaseMesh&, uint maxVertices = DEFAULT_MAX_VERTICES, uint maxTriangles = DEFAULT_MAX_TRIANGLES);
+
+		static Bounds computeBounds(const BaseMesh&, const Meshlets&, const Meshlet&);
+
+		/* Append the index of the visible clusters */
+		static void cull(const Meshlets&, const CullParameter&, eastl::vector<uint>& visible);
+
+		/* Merge the visible clusters which follow each other in the index buffer */
+		static eastl::vector<DrawRange> drawRanges(const Meshlets&, const eastl::vector<uint>& visible);
+	};
+}
@@ -0,0 +1,517 @@
+#include "ObjFile.h"
+#include "Parallel.h"
+
+#include <EASTL/unordered_map.h>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+
+namespace tim
+{
+
+namespace
+{
+	const uint CHUNK_SIZE = 1 << 14; // elements formatted by a task
+	const uint MAX_ELEMENT_SIZE = 160; // a quad with 3 indices of 10 digits per corner
+	const uint CHUNKS_PER_THREAD = 2; // chunks kept in memory before being written
+
+	char* writeUint(char* p, uint v)
+	{
+		char tmp[10];
+		int n = 0;
+		do
+		{
+			tmp[n++] = char('0' + v % 10);
+			v /= 10;
+		} while (v != 0);
+
+		while (n > 0)
+			*p++ = tmp[--n];
+		return p;
+	}
+
+	const double POW10[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+	/* 6 significant digits, trailing zeros removed, as the default of the streams (%g) which is used out of [1e-4, 1e6) */
+	char* writeFloat(char* p, float v)
+	{
+		const double a = fabs(double(v));
+		if (!std::isfinite(v) || a >= 1e6 || (a < 1e-4 && a != 0))
+			return p + snprintf(p, 32, "%g", v);
+
+		// the decimals putting the first significant digit at 1e5
+		int decimals = 0;
+		while (decimals < 9 && a * POW10[decimals] < 1e5)
+			++decimals;
+
+		// the ties to even as printf
+		uint64_t scaled = uint64_t(nearbyint(a * POW10[decimals]));
+		if (scaled >= 1000000)
+		{
+			// rounded up to the next power of 10
+			if (decimals == 0)
+				return p + snprintf(p, 32, "%g", v);
+			scaled /= 10;
+			--decimals;
+		}
+
+		const uint64_t unit = uint64_t(POW10[decimals]);
+		uint integer = uint(scaled / unit);
+		uint frac = uint(scaled % unit);
+
+		if (std::signbit(v))
+			*p++ = '-';
+		p = writeUint(p, integer);
+
+		if (frac != 0)
+		{
+			*p++ = '.';
+			int nbDigits = decimals;
+			while (frac % 10 == 0)
+			{
+				frac /= 10;
+				--nbDigits;
+			}
+
+			for (int i = nbDigits - 1; i >= 0; --i)
+			{
+				p[i] = char('0' + frac % 10);
+				frac /= 10;
+			}
+			p += nbDigits;
+		}
+		return p;
+	}
+
+	char* writeCorner(char* p, uint index, bool withNormals, bool withUV)
+	{
+		++index;
+		p = writeUint(p, index);
+		if (withUV || withNormals)
+		{
+			*p++ = '/';
+			if (withUV)
+				p = writeUint(p, index);
+			if (withNormals)
+			{
+				*p++ = '/';
+				p = writeUint(p, index);
+			}
+		}
+		return p;
+	}
+
+	/* Parsing */
+
+	struct Corner
+	{
+		int v, t, n; // -1 when absent
+
+		bool operator==(const Corner& c) const { return v == c.v && t == c.t && n == c.n; }
+	};
+
+	struct CornerHash
+	{
+		size_t operator()(const Corner& c) const { return size_t(c.v) * 73856093u ^ size_t(c.t) * 19349663u ^ size_t(c.n) * 83492791u; }
+	};
+
+	struct ObjFace
+	{
+		int nbCorners;
+		Corner corners[4];
+	};
+
+	bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	void skipSpaces(const char*& p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			++p;
+	}
+
+	void skipLine(const char*& p, const char* end)
+	{
+		while (p < end && *p != '\n')
+			++p;
+		if (p < end)
+			++p;
+	}
+
+	bool endOfLine(const char* p, const char* end) { return p >= end || *p == '\n' || *p == '#'; }
+
+	bool parseInt(const char*& p, const char* end, int& out)
+	{
+		bool negative = p < end && *p == '-';
+		if (negative || (p < end && *p == '+'))
+			++p;
+
+		if (p >= end || *p < '0' || *p > '9')
+			return false;
+
+		int64_t v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			v = v * 10 + (*p++ - '0');
+			if (v > INT32_MAX)
+				return false;
+		}
+
+		out = int(negative ? -v : v);
+		return true;
+	}
+
+	bool parseFloat(const char*& p, const char* end, float& out)
+	{
+		static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+		bool negative = p < end && *p == '-';
+		if (negative || (p < end && *p == '+'))
+			++p;
+
+		uint64_t mantissa = 0;
+		int exponent = 0, nbDigits = 0;
+
+		for (; p < end && *p >= '0' && *p <= '9'; ++p, ++nbDigits)
+		{
+			if (mantissa < 100000000000000000ull)
+				mantissa = mantissa * 10 + uint64_t(*p - '0');
+			else
+				++exponent;
+		}
+
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++nbDigits)
+			{
+				if (mantissa < 100000000000000000ull)
+				{
+					mantissa = mantissa * 10 + uint64_t(*p - '0');
+					--exponent;
+				}
+			}
+		}
+
+		if (nbDigits == 0)
+		{
+			// inf and nan are not supported, the files come from our exporter or modelers
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			int e;
+			if (!parseInt(p, end, e))
+				return false;
+			exponent += e;
+		}
+
+		double v = double(mantissa);
+		if (exponent < 0)
+			v = -exponent <= 18 ? v / POW10[-exponent] : v * pow(10.0, exponent);
+		else if (exponent > 0)
+			v = exponent <= 18 ? v * POW10[exponent] : v * pow(10.0, exponent);
+
+		out = float(negative ? -v : v);
+		return true;
+	}
+
+	/* OBJ indices start at 1, negative ones are relative to the end */
+	bool resolveIndex(int index, size_t count, int& out)
+	{
+		int64_t i = index < 0 ? int64_t(count) + index : int64_t(index) - 1;
+		if (index == 0 || i < 0 || i >= int64_t(count))
+			return false;
+
+		out = int(i);
+		return true;
+	}
+
+	bool parseCorner(const char*& p, const char* end, size_t nbPositions, size_t nbTexCoords, size_t nbNormals, Corner& corner)
+	{
+		int index;
+		corner.t = corner.n = -1;
+
+		if (!parseInt(p, end, index) || !resolveIndex(index, nbPositions, corner.v))
+			return false;
+
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (p < end && *p != '/')
+			{
+				if (!parseInt(p, end, index) || !resolveIndex(index, nbTexCoords, corner.t))
+					return false;
+			}
+
+			if (p < end && *p == '/')
+			{
+				++p;
+				if (!parseInt(p, end, index) || !resolveIndex(index, nbNormals, corner.n))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	template<int N, class V>
+	bool parseVector(const char*& p, const char* end, eastl::vector<V>& out)
+	{
+		V v;
+		for (int i = 0; i < N; ++i)
+		{
+			skipSpaces(p, end);
+			if (!parseFloat(p, end, v[i]))
+				return false;
+		}
+
+		out.push_back(v);
+		return true;
+	}
+}
+
+bool ObjFile::write(const BaseMesh& mesh, const eastl::string& path)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cerr << "Unuable to open " << path.c_str() << std::endl;
+		return false;
+	}
+
+	const bool withNormals = !mesh._normals.empty();
+	const bool withUV = !mesh._texCoords.empty();
+
+	// the elements are numbered across the sections, in the order they are written
+	const size_t sectionEnd[4] = { mesh._vertices.size(),
+								   mesh._vertices.size() + mesh._normals.size(),
+								   mesh._vertices.size() + mesh._normals.size() + mesh._texCoords.size(),
+								   mesh._vertices.size() + mesh._normals.size() + mesh._texCoords.size() + mesh._faces.size() };
+
+	const uint nbChunks = uint((sectionEnd[3] + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	const uint chunksPerBatch = eastl::max(1u, uint(g_threadPool.size()) * CHUNKS_PER_THREAD);
+
+	eastl::vector<eastl::vector<char>> buffers(eastl::min(nbChunks, chunksPerBatch));
+	bool ok = true;
+
+	for (uint firstChunk = 0; firstChunk < nbChunks && ok; firstChunk += chunksPerBatch)
+	{
+		uint nbBatchChunks = eastl::min(chunksPerBatch, nbChunks - firstChunk);
+
+		parallelFor(nbBatchChunks, [&](uint c)
+		{
+			size_t begin = size_t(firstChunk + c) * CHUNK_SIZE;
+			size_t end = eastl::min(begin + CHUNK_SIZE, sectionEnd[3]);
+
+			auto& buffer = buffers[c];
+			buffer.resize((end - begin) * MAX_ELEMENT_SIZE);
+			char* p = buffer.data();
+
+			for (size_t e = begin; e < end; ++e)
+			{
+				if (e < sectionEnd[0])
+				{
+					const vec3& v = mesh._vertices[e];
+					*p++ = 'v'; *p++ = ' ';
+					p = writeFloat(p, v.x()); *p++ = ' ';
+					p = writeFloat(p, v.y()); *p++ = ' ';
+					p = writeFloat(p, v.z());
+				}
+				else if (e < sectionEnd[1])
+				{
+					const vec3& v = mesh._normals[e - sectionEnd[0]];
+					*p++ = 'v'; *p++ = 'n'; *p++ = ' ';
+					p = writeFloat(p, v.x()); *p++ = ' ';
+					p = writeFloat(p, v.y()); *p++ = ' ';
+					p = writeFloat(p, v.z());
+				}
+				else if (e < sectionEnd[2])
+				{
+					const vec2& v = mesh._texCoords[e - sectionEnd[1]];
+					*p++ = 'v'; *p++ = 't'; *p++ = ' ';
+					p = writeFloat(p, v.x()); *p++ = ' ';
+					p = writeFloat(p, v.y());
+				}
+				else
+				{
+					const BaseMesh::Face& f = mesh._faces[e - sectionEnd[2]];
+					if (f.nbIndexes < 2 || f.nbIndexes > 4)
+						continue;
+
+					*p++ = f.nbIndexes == 2 ? 'l' : 'f';
+					for (int i = 0; i < f.nbIndexes; ++i)
+					{
+						*p++ = ' ';
+						p = writeCorner(p, f.indexes[i], withNormals, withUV);
+					}
+				}
+				*p++ = '\n';
+			}
+
+			buffer.resize(p - buffer.data());
+		});
+
+		for (uint c = 0; c < nbBatchChunks && ok; ++c)
+			ok = fwrite(buffers[c].data(), 1, buffers[c].size(), file) == buffers[c].size();
+	}
+
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		std::cerr << "Error while writing " << path.c_str() << std::endl;
+	return ok;
+}
+
+bool ObjFile::read(const eastl::string& path, BaseMesh& mesh)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		std::cerr << "Unuable to open " << path.c_str() << std::endl;
+		return false;
+	}
+
+	eastl::vector<char> data;
+	char buffer[1 << 16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + n);
+	fclose(file);
+
+	eastl::vector<vec3> positions, normals;
+	eastl::vector<vec2> texCoords;
+	eastl::vector<ObjFace> faces;
+
+	const char* p = data.data();
+	const char* end = p + data.size();
+	uint line = 1;
+	bool ok = true;
+
+	for (; p < end; skipLine(p, end), ++line)
+	{
+		skipSpaces(p, end);
+		if (endOfLine(p, end))
+			continue;
+
+		if (p + 1 < end && p[0] == 'v' && isSpace(p[1]))
+			ok = parseVector<3>(++p, end, positions);
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+			ok = parseVector<3>(p += 2, end, normals);
+		else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
+			ok = parseVector<2>(p += 2, end, texCoords);
+		else if (p + 1 < end && (p[0] == 'f' || p[0] == 'l') && isSpace(p[1]))
+		{
+			const bool isLine = *p == 'l';
+			++p;
+
+			eastl::vector<Corner> corners;
+			for (skipSpaces(p, end); !endOfLine(p, end) && ok; skipSpaces(p, end))
+			{
+				Corner c;
+				ok = parseCorner(p, end, positions.size(), texCoords.size(), normals.size(), c);
+				corners.push_back(c);
+			}
+
+			if (!ok || corners.size() < 2 || (!isLine && corners.size() < 3))
+			{
+				ok = false;
+				break;
+			}
+
+			if (isLine)
+			{
+				for (size_t i = 0; i + 1 < corners.size(); ++i)
+					faces.push_back({ 2, { corners[i], corners[i + 1] } });
+			}
+			else if (corners.size() <= 4)
+			{
+				ObjFace face = { int(corners.size()), {} };
+				for (size_t i = 0; i < corners.size(); ++i)
+					face.corners[i] = corners[i];
+				faces.push_back(face);
+			}
+			else
+			{
+				for (size_t i = 1; i + 1 < corners.size(); ++i)
+					faces.push_back({ 3, { corners[0], corners[i], corners[i + 1] } });
+			}
+		}
+		// o, g, s, usemtl, mtllib... are ignored
+
+		if (!ok)
+			break;
+	}
+
+	if (!ok)
+	{
+		std::cerr << "Malformed obj " << path.c_str() << " at line " << line << std::endl;
+		return false;
+	}
+
+	bool withUV = false, withNormals = false, sameIndex = true;
+	for (const ObjFace& f : faces)
+	{
+		for (int i = 0; i < f.nbCorners; ++i)
+		{
+			const Corner& c = f.corners[i];
+			withUV |= c.t >= 0;
+			withNormals |= c.n >= 0;
+			sameIndex &= (c.t < 0 || c.t == c.v) && (c.n < 0 || c.n == c.v);
+		}
+	}
+
+	mesh = BaseMesh();
+	mesh._faces.reserve(faces.size());
+
+	// the usual case, written by our exporter: one index for all the attributes
+	if (sameIndex && (!withUV || texCoords.size() == positions.size()) && (!withNormals || normals.size() == positions.size()))
+	{
+		mesh._vertices = eastl::move(positions);
+		if (withNormals)
+			mesh._normals = eastl::move(normals);
+		if (withUV)
+			mesh._texCoords = eastl::move(texCoords);
+
+		for (const ObjFace& f : faces)
+		{
+			BaseMesh::Face face;
+			face.nbIndexes = f.nbCorners;
+			for (int i = 0; i < f.nbCorners; ++i)
+				face.indexes[i] = uint(f.corners[i].v);
+			mesh._faces.push_back(face);
+		}
+		return true;
+	}
+
+	// a vertex for each distinct (position, uv, normal), the missing attributes are zero
+	eastl::unordered_map<Corner, uint, CornerHash> vertexIndex;
+	vertexIndex.reserve(positions.size());
+
+	for (const ObjFace& f : faces)
+	{
+		BaseMesh::Face face;
+		face.nbIndexes = f.nbCorners;
+
+		for (int i = 0; i < f.nbCorners; ++i)
+		{
+			const Corner& c = f.corners[i];
+			auto it = vertexIndex.find(c);
+			if (it == vertexIndex.end())
+			{
+				it = vertexIndex.insert(eastl::make_pair(c, uint(mesh._vertices.size()))).first;
+				mesh._vertices.push_back(positions[c.v]);
+				if (withNormals)
+					mesh._normals.push_back(c.n >= 0 ? normals[c.n] : vec3());
+				if (withUV)
+					mesh._texCoords.push_back(c.t >= 0 ? texCoords[c.t] : vec2());
+			}
+			face.indexes[i] = it->second;
+		}
+
+		mesh._faces.push_back(face);
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Mesh.h"
+
+namespace tim
+{
+	/* Streaming OBJ export and import.
+	   The writer formats the vertices and faces by chunks in parallel, in large buffers, and writes the chunks in order.
+	   The reader loads the whole file and parses it without the streams. Faces with several indices per corner (v/vt/vn)
+	   are unified into the single index of BaseMesh, polygons with more than 4 corners are triangulated in fan. */
+	class ObjFile
+	{
+	public:
+		ObjFile() = delete;
+
+		static bool write(const BaseMesh&, const eastl::string& path);
+
+		/* Load into a BaseMesh, Mesh or UVMesh, false if the file can't be read or is malformed */
+		static bool read(const eastl::string& path, BaseMesh&);
+	};
+}
@@ -0,0 +1,223 @@
+#include "TubeMesher.h"
+#include "Parallel.h"
+
+namespace tim
+{
+
+const uint TubeMesher::NO_TUBE;
+
+namespace
+{
+	const uint TUBES_PER_TASK = 16;
+
+	/* Rotate the normal of the frame at p0 with tangent t0 to the frame at p1 with tangent t1, Wang et al. double reflection */
+	vec3 transportNormal(vec3 normal, vec3 p0, vec3 t0, vec3 p1, vec3 t1)
+	{
+		vec3 v1 = p1 - p0;
+		float c1 = v1.dot(v1);
+		if (c1 < 1e-12f)
+			return normal;
+
+		vec3 rL = normal - v1 * (2.f / c1 * v1.dot(normal));
+		vec3 tL = t0 - v1 * (2.f / c1 * v1.dot(t0));
+
+		vec3 v2 = t1 - tL;
+		float c2 = v2.dot(v2);
+		vec3 r = c2 < 1e-12f ? rL : rL - v2 * (2.f / c2 * v2.dot(rL));
+
+		// keep it orthonormal against the drift
+		return (r - t1 * r.dot(t1)).normalized();
+	}
+
+	/* Distance of p to the segment [a,b] */
+	float distanceToSegment(vec3 p, vec3 a, vec3 b, float& t)
+	{
+		vec3 ab = b - a;
+		float l2 = ab.length2();
+		t = l2 > 0 ? eastl::max(0.f, eastl::min(1.f, (p - a).dot(ab) / l2)) : 0.f;
+		return (p - (a + ab * t)).length();
+	}
+}
+
+float TubeMesher::worldError(float pixelError, float distance, float fovY, float screenHeight)
+{
+	return pixelError * 2 * distance * tanf(fovY * 0.5f) / screenHeight;
+}
+
+uint TubeMesher::ringResolution(float radius, float maxError, uint maxResolution)
+{
+	maxResolution = eastl::max(3u, maxResolution);
+	if (maxError <= 0)
+		return maxResolution;
+	if (maxError >= radius)
+		return 3;
+
+	// the chord of a side of a regular polygon is at radius*(1 - cos(PI/n)) from the circle
+	float n = ceilf(PI / acosf(1.f - maxError / radius));
+	return eastl::max(3u, eastl::min(maxResolution, uint(n)));
+}
+
+TubeMesher::TubeMesher(const Parameter& param) : _param(param)
+{
+	_param.resolution = eastl::max(3u, _param.resolution);
+}
+
+uint TubeMesher::addTube(const Curve& curve)
+{
+	const uint nbPoints = uint(curve.numPoints());
+	if (nbPoints < 3)
+		return NO_TUBE;
+
+	Tube tube;
+	tube.curve = &curve;
+	tube.firstRing = uint(_rings.size());
+
+	if (_param.maxError > 0)
+	{
+		float maxRadius = 0;
+		for (uint i = 0; i < nbPoints - 1; ++i)
+			maxRadius = eastl::max(maxRadius, curve.radius(i));
+		tube.resolution = ringResolution(maxRadius, _param.maxError, _param.resolution);
+
+		// extend the segment from the last ring while the skipped points stay close to it, the tip ends the last one
+		uint last = 0;
+		_rings.push_back(0);
+		for (uint end = 2; end < nbPoints; ++end)
+		{
+			bool fits = true;
+			for (uint j = last + 1; j < end && fits; ++j)
+			{
+				float t;
+				float d = distanceToSegment(curve.point(j), curve.point(last), curve.point(end), t);
+				float r = interpolate(curve.radius(last), curve.radius(end), t);
+				fits = d <= _param.maxError && fabsf(curve.radius(j) - r) <= _param.maxError;
+			}
+
+			if (!fits)
+			{
+				last = end - 1;
+				_rings.push_back(last);
+			}
+		}
+	}
+	else
+	{
+		tube.resolution = _param.resolution;
+		for (uint i = 0; i < nbPoints - 1; ++i)
+			_rings.push_back(i);
+	}
+
+	tube.nbRings = uint(_rings.size()) - tube.firstRing;
+	const uint res = tube.resolution;
+	const uint nbRings = tube.nbRings;
+
+	tube.firstVertex = _nbVertices;
+	tube.firstFace = _nbFaces;
+
+	_nbVertices += nbRings * res + 1;
+	_nbFaces += (nbRings - 1) * res * (_param.triangulate ? 2 : 1) + res;
+
+	_tubes.push_back(tube);
+	return uint(_tubes.size()) - 1;
+}
+
+void TubeMesher::build(BaseMesh& mesh) const
+{
+	mesh = BaseMesh();
+	mesh._vertices.resize(_nbVertices);
+	mesh._faces.resize(_nbFaces);
+	if (_param.withUV)
+		mesh._texCoords.resize(_nbVertices);
+
+	const uint nbTasks = (uint(_tubes.size()) + TUBES_PER_TASK - 1) / TUBES_PER_TASK;
+	parallelFor(nbTasks, [&](uint task)
+	{
+		const uint last = eastl::min(uint(_tubes.size()), (task + 1) * TUBES_PER_TASK);
+		for (uint t = task * TUBES_PER_TASK; t < last; ++t)
+			buildTube(mesh, _tubes[t]);
+	});
+}
+
+void TubeMesher::buildTube(BaseMesh& mesh, const Tube& tube) const
+{
+	const Curve& curve = *tube.curve;
+	const uint res = tube.resolution;
+	const uint nbRings = tube.nbRings;
+	const uint* rings = _rings.data() + tube.firstRing;
+	const uint tipPoint = uint(curve.numPoints()) - 1;
+
+	vec3* vertices = mesh._vertices.data() + tube.firstVertex;
+	vec2* uvs = _param.withUV ? mesh._texCoords.data() + tube.firstVertex : nullptr;
+	BaseMesh::Face* faces = mesh._faces.data() + tube.firstFace;
+
+	// the angles are the same for every ring
+	const vec2* cosSin = UnitCircle::table(res);
+
+	vec3 dir = curve.computeDirection(rings[0]);
+	vec3 normal = dir.cross(dir.orthoDir()).normalized();
+	float length = 0;
+
+	// v follows the length of the curve, the skipped points included
+	auto lengthBetween = [&](uint from, uint to)
+	{
+		float l = 0;
+		for (uint k = from; k < to; ++k)
+			l += (curve.point(k + 1) - curve.point(k)).length();
+		return l;
+	};
+
+	for (uint i = 0; i < nbRings; ++i)
+	{
+		const vec3 p = curve.point(rings[i]);
+		if (i > 0)
+		{
+			const vec3 prevDir = dir;
+			dir = curve.computeDirection(rings[i]);
+			normal = transportNormal(normal, curve.point(rings[i - 1]), prevDir, p, dir);
+			length += lengthBetween(rings[i - 1], rings[i]);
+		}
+
+		const vec3 binormal = normal.cross(dir);
+		const float radius = curve.radius(rings[i]);
+
+		for (uint j = 0; j < res; ++j)
+		{
+			vertices[i * res + j] = p + (normal * cosSin[j].x() + binormal * cosSin[j].y()) * radius;
+			if (uvs)
+			{
+				const float around = float(j) / res;
+				uvs[i * res + j] = vec2(TAU * radius * eastl::min(around, 1.f - around), length);
+			}
+		}
+	}
+
+	// the tip
+	const uint tip = nbRings * res;
+	vertices[tip] = curve.point(tipPoint);
+	if (uvs)
+		uvs[tip] = vec2(0, length + lengthBetween(rings[nbRings - 1], tipPoint));
+
+	// same winding as Curve::convertToMesh
+	uint f = 0;
+	for (uint i = 1; i < nbRings; ++i)
+	{
+		const uint bottom = tube.firstVertex + (i - 1) * res, top = tube.firstVertex + i * res;
+		for (uint j = 0; j < res; ++j)
+		{
+			const uint j1 = (j + 1) % res;
+			if (_param.triangulate)
+			{
+				faces[f++] = { { bottom + j, top + j, bottom + j1, 0 }, 3 };
+				faces[f++] = { { top + j, top + j1, bottom + j1, 0 }, 3 };
+			}
+			else
+				faces[f++] = { { bottom + j, top + j, top + j1, bottom + j1 }, 4 };
+		}
+	}
+
+	const uint lastRing = tube.firstVertex + (nbRings - 1) * res;
+	for (uint j = 0; j < res; ++j)
+		faces[f++] = { { lastRing + j, tube.firstVertex + tip, lastRing + (j + 1) % res, 0 }, 3 };
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Curve.h"
+
+namespace tim
+{
+	/* Tubes along curves, for the branches of a tree.
+	   The rings are oriented with parallel transport: the normal of a ring is the normal of the previous one rotated
+	   with the minimal rotation between the two directions (double reflection), so the consecutive rings are aligned
+	   without searching the best rotation. The last point of a curve is the tip of the tube.
+	   There is no seam vertex, u goes around the tube and back (mirrored), v is the length along the curve.
+	   The start of a tube is left open, as a branch starts inside its parent: a child tube shares no vertex with its parent.
+	   The sizes are known once the tubes are added, build() writes the vertices and the faces in place, the tubes in parallel.
+
+	   With maxError > 0 the tessellation is adaptive, maxError being the largest distance allowed to the exact tube:
+	   the number of sides of a tube is the smallest keeping the chord of its largest ring within maxError, up to resolution,
+	   and the rings on the nearly straight parts, where the axis and the radius stay within maxError of the segment
+	   joining the kept rings, are dropped. A tube keeps the same number of sides from its start to its tip so it has no crack. */
+	class TubeMesher
+	{
+	public:
+		static const uint NO_TUBE = uint(-1);
+
+		struct Parameter
+		{
+			uint resolution = 8; // the number of sides, the maximum in adaptive mode
+			bool withUV = true;
+			bool triangulate = true;
+			float maxError = 0; // in world space, 0 for a fixed resolution and every point of the curves
+		};
+
+		explicit TubeMesher(const Parameter&);
+
+		/* The curve must outlive the mesher, curves with less than 3 points are ignored as in Curve::convertToMesh. Returns the index of the tube */
+		uint addTube(const Curve&);
+
+		uint nbVertices() const { return _nbVertices; }
+		uint nbFaces() const { return _nbFaces; }
+
+		/* Replace the content of the mesh */
+		void build(BaseMesh&) const;
+
+		/* World space error seen as pixelError pixels at a distance, for a vertical fov in radians */
+		static float worldError(float pixelError, float distance, float fovY, float screenHeight);
+
+		/* Smallest number of sides, at least 3, for a ring of this radius to stay within maxError of the circle */
+		static uint ringResolution(float radius, float maxError, uint maxResolution);
+
+	private:
+		struct Tube
+		{
+			const Curve* curve;
+			uint resolution;
+			uint firstRing, nbRings; // in _rings, the points of the curve with a ring
+			uint firstVertex, firstFace;
+		};
+
+		Parameter _param;
+		eastl::vector<Tube> _tubes;
+		eastl::vector<uint> _rings;
+		uint _nbVertices = 0, _nbFaces = 0;
+
+		void buildTube(BaseMesh&, const Tube&) const;
+	};
+}
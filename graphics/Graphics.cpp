@@ -97,12 +97,15 @@ void Graphics::close()
 	_renderer.close();
 }
 
-Material Graphics::createTexturedForwardMaterial(const char* shaderSrc, const eastl::shared_ptr<TexturePool>& pool, bool cullFace, bool wireFrame)
+Material Graphics::createTexturedForwardMaterial(const char* shaderSrc, const eastl::shared_ptr<TexturePool>& pool, bool cullFace, bool wireFrame, bool quantized)
 {
 	Material mat;
 
 	dx12::DX12InputLayout inLayout;
-	inLayout.initAsFloatVectors({ {"VERTEX", 3}, {"NORMAL", 3},{ "UV", 2 } });
+	if (quantized)
+		inLayout.initWithFormats({ { "VERTEX", DXGI_FORMAT_R16G16B16A16_UNORM },{ "NORMAL", DXGI_FORMAT_R16G16_SNORM },{ "UV", DXGI_FORMAT_R16G16_UNORM } });
+	else
+		inLayout.initAsFloatVectors({ {"VERTEX", 3}, {"NORMAL", 3},{ "UV", 2 } });
 	inLayout.addMat4PerInstanceElement({ "MODEL_MATRIX" });
 	inLayout.addPerInstanceMaterial();
 
@@ -118,12 +121,15 @@ Material Graphics::createTexturedForwardMaterial(const char* shaderSrc, const ea
 	return mat;
 }
 
-Material Graphics::createPointToTriangleGSForwardMaterial(const char* shaderSrc, const eastl::shared_ptr<TexturePool>& pool, bool cullFace, bool wireFrame)
+Material Graphics::createPointToTriangleGSForwardMaterial(const char* shaderSrc, const eastl::shared_ptr<TexturePool>& pool, bool cullFace, bool wireFrame, bool quantized)
 {
 	Material mat;
 	
 	dx12::DX12InputLayout inLayout;
-	inLayout.initAsFloatVectors({ { "VERTEX", 3 },{ "NORMAL", 3 } });
+	if (quantized)
+		inLayout.initWithFormats({ { "VERTEX", DXGI_FORMAT_R16G16B16A16_UNORM } });
+	else
+		inLayout.initAsFloatVectors({ { "VERTEX", 3 },{ "NORMAL", 3 } });
 	inLayout.addMat4PerInstanceElement({ "MODEL_MATRIX" });
 	inLayout.addPerInstanceMaterial();
 
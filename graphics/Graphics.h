@@ -27,11 +27,13 @@ public:
 	void close();
 
 	//Material createForwardMaterial(bool cullFace = true, bool wireFrame = false);
+
+	// quantized : vertices encoded by MeshEncoder (OCT_SNORM16 for the textured material, OCT_SNORM8 without uv for the points)
 	Material createTexturedForwardMaterial(const char* shader, const eastl::shared_ptr<TexturePool>& pool = eastl::make_shared<TexturePool>(16),
-										   bool cullFace = true, bool wireFrame = false);
+										   bool cullFace = true, bool wireFrame = false, bool quantized = false);
 
 	Material createPointToTriangleGSForwardMaterial(const char* shader, const eastl::shared_ptr<TexturePool>& pool = eastl::make_shared<TexturePool>(16),
-										   bool cullFace = true, bool wireFrame = false);
+										   bool cullFace = true, bool wireFrame = false, bool quantized = false);
 
 	static ProxyTexture g_dummyTexture;
 
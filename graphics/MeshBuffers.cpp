@@ -83,4 +83,114 @@ eastl::shared_ptr<dx12::GpuBuffer> MeshBuffers::createVertexBufferFromMesh(const
 		commandContext.finish(true);
 
 	return eastl::shared_ptr<dx12::GpuBuffer>(vb);
-}
\ No newline at end of file
+}
+
+namespace
+{
+	void uploadByChunk(dx12::CommandContext& commandContext, dx12::GpuBuffer& buffer, const byte* data, size_t bufferSize, bool flush)
+	{
+		for (size_t i = 0; i < bufferSize; i += (1 << 20))
+		{
+			size_t numBytes = eastl::min(size_t(1 << 20), bufferSize - i);
+			commandContext.initBuffer(buffer, data + i, numBytes, i);
+
+			if (i > 0 && i % (20 << 20) == 0 && flush)
+				commandContext.flush(true);
+		}
+	}
+}
+
+MeshBuffers MeshBuffers::createFromEncodedMesh(const tim::MeshEncoder::EncodedMesh& encoded, const tim::BaseMesh& mesh, uint64_t* fence, tim::uint nbPointInFace)
+{
+	if (encoded.nbVertices == 0)
+		return MeshBuffers();
+
+	auto indexBuffer = mesh.indexData(nbPointInFace);
+	if (indexBuffer.empty())
+		return MeshBuffers();
+
+	dx12::GpuBuffer* vb = new dx12::GpuBuffer(encoded.nbVertices, encoded.stride);
+	dx12::GpuBuffer* ib = new dx12::GpuBuffer(indexBuffer.size(), sizeof(tim::uint));
+
+	auto& commandContext = dx12::CommandContext::AllocContext(dx12::CommandQueue::COPY);
+
+	uploadByChunk(commandContext, *vb, encoded.vertexData.data(), encoded.vertexData.size(), fence == nullptr);
+	uploadByChunk(commandContext, *ib, (const byte*)indexBuffer.data(), indexBuffer.size() * sizeof(tim::uint), fence == nullptr);
+
+	if (fence != nullptr)
+		*fence = commandContext.finish(false);
+	else
+		commandContext.finish(true);
+
+	MeshBuffers res;
+	res._vb = eastl::shared_ptr<dx12::GpuBuffer>(vb);
+	res._ib = eastl::shared_ptr<dx12::GpuBuffer>(ib);
+	res.setDecode(encoded);
+	return res;
+}
+
+eastl::shared_ptr<dx12::GpuBuffer> MeshBuffers::createVertexBufferFromEncodedMesh(const tim::MeshEncoder::EncodedMesh& encoded, uint64_t* fence)
+{
+	if (encoded.nbVertices == 0)
+		return eastl::shared_ptr<dx12::GpuBuffer>();
+
+	dx12::GpuBuffer* vb = new dx12::GpuBuffer(encoded.nbVertices, encoded.stride);
+
+	auto& commandContext = dx12::CommandContext::AllocContext(dx12::CommandQueue::COPY);
+	uploadByChunk(commandContext, *vb, encoded.vertexData.data(), encoded.vertexData.size(), fence == nullptr);
+
+	if (fence != nullptr)
+		*fence = commandContext.finish(false);
+	else
+		commandContext.finish(true);
+
+	return eastl::shared_ptr<dx12::GpuBuffer>(vb);
+}
+
+eastl::shared_ptr<dx12::GpuBuffer> MeshBuffers::createIndexBuffer(const eastl::vector<tim::uint>& indices, uint64_t* fence)
+{
+	if (indices.empty())
+		return eastl::shared_ptr<dx12::GpuBuffer>();
+
+	dx12::GpuBuffer* ib = new dx12::GpuBuffer(indices.size(), sizeof(tim::uint));
+
+	auto& commandContext = dx12::CommandContext::AllocContext(dx12::CommandQueue::COPY);
+	uploadByChunk(commandContext, *ib, (const byte*)indices.data(), indices.size() * sizeof(tim::uint), fence == nullptr);
+
+	if (fence != nullptr)
+		*fence = commandContext.finish(false);
+	else
+		commandContext.finish(true);
+
+	return eastl::shared_ptr<dx12::GpuBuffer>(ib);
+}
+
+eastl::vector<MeshBuffers> MeshBuffers::createFromMeshFile(const tim::MeshFile::Part& part, uint64_t* fence)
+{
+	eastl::vector<MeshBuffers> lods;
+	if (part.encodedVertices.empty() || part.indices.empty())
+		return lods;
+
+	auto vb = eastl::make_shared<dx12::GpuBuffer>(part.nbVertices, part.encodedStride);
+	auto ib = eastl::make_shared<dx12::GpuBuffer>(part.indices.size, sizeof(tim::uint));
+
+	auto& commandContext = dx12::CommandContext::AllocContext(dx12::CommandQueue::COPY);
+
+	uploadByChunk(commandContext, *vb, part.encodedVertices.data, part.encodedVertices.size, fence == nullptr);
+	uploadByChunk(commandContext, *ib, (const byte*)part.indices.data, part.indices.size * sizeof(tim::uint), fence == nullptr);
+
+	if (fence != nullptr)
+		*fence = commandContext.finish(false);
+	else
+		commandContext.finish(true);
+
+	for (const auto& lod : part.lods)
+	{
+		MeshBuffers res(vb, ib, lod.firstIndex, lod.nbIndices);
+		res.setDecode(tim::vec4(lod.positionDecode[0], lod.positionDecode[1], lod.positionDecode[2], lod.positionDecode[3]),
+					  tim::vec4(lod.uvDecode[0], lod.uvDecode[1], lod.uvDecode[2], lod.uvDecode[3]));
+		lods.push_back(res);
+	}
+
+	return lods;
+}
@@ -3,6 +3,8 @@
 #include "API.h"
 #include <EASTL/shared_ptr.h>
 #include <geometry\Mesh.h>
+#include <geometry\MeshEncoder.h>
+#include <geometry\MeshFile.h>
 
 class MeshBuffers
 {
@@ -25,25 +27,52 @@ public:
 	static MeshBuffers createFromMesh(const tim::BaseMesh&, uint64_t* fence = nullptr, tim::uint nbPointInFace = 3, bool useNormal = true, bool useUV = true);
 	static eastl::shared_ptr<dx12::GpuBuffer> createVertexBufferFromMesh(const tim::BaseMesh&, uint64_t* fence = nullptr);
 
+	/* Quantized vertices, the faces are taken from the mesh which was encoded */
+	static MeshBuffers createFromEncodedMesh(const tim::MeshEncoder::EncodedMesh&, const tim::BaseMesh& faces, uint64_t* fence = nullptr, tim::uint nbPointInFace = 3);
+	static eastl::shared_ptr<dx12::GpuBuffer> createVertexBufferFromEncodedMesh(const tim::MeshEncoder::EncodedMesh&, uint64_t* fence = nullptr);
+
+	/* Indices shared by several meshes, each one with its own vertex buffer */
+	static eastl::shared_ptr<dx12::GpuBuffer> createIndexBuffer(const eastl::vector<tim::uint>&, uint64_t* fence = nullptr);
+
+	/* Upload the encoded vertices and the indices of a part straight from the file, one MeshBuffers per lod sharing the buffers */
+	static eastl::vector<MeshBuffers> createFromMeshFile(const tim::MeshFile::Part&, uint64_t* fence = nullptr);
+
 	void setOffset(size_t);
+	void setBaseVertex(tim::uint); // added to the indices, for the meshes sharing a vertex buffer
 	void setNumIndices(int64_t);
 	void setTopology(Topology);
+	void setDecode(const tim::MeshEncoder::EncodedMesh&);
+	void setDecode(const tim::vec4& positionDecode, const tim::vec4& uvDecode);
 
 	size_t offset() const;
+	tim::uint baseVertex() const;
 	int64_t numIndices() const;
 	Topology topology() const;
+	const tim::vec4& positionDecode() const;
+	const tim::vec4& uvDecode() const;
 
 private:
 	eastl::shared_ptr<dx12::GpuBuffer> _vb, _ib;
 	size_t _offset = 0;
+	tim::uint _baseVertex = 0;
 	int64_t _numIndexes = -1;
 	Topology _topology = Triangles;
+
+	// identity for float vertices
+	tim::vec4 _positionDecode = { 0,0,0,1 };
+	tim::vec4 _uvDecode = { 0,0,1,1 };
 };
 
 inline void MeshBuffers::setOffset(size_t o) { _offset = o; }
+inline void MeshBuffers::setBaseVertex(tim::uint v) { _baseVertex = v; }
 inline void MeshBuffers::setNumIndices(int64_t n) { _numIndexes = n; }
 inline void MeshBuffers::setTopology(Topology topo) { _topology = topo; }
+inline void MeshBuffers::setDecode(const tim::MeshEncoder::EncodedMesh& mesh) { _positionDecode = mesh.positionDecode; _uvDecode = mesh.uvDecode; }
+inline void MeshBuffers::setDecode(const tim::vec4& positionDecode, const tim::vec4& uvDecode) { _positionDecode = positionDecode; _uvDecode = uvDecode; }
 
 inline size_t MeshBuffers::offset() const { return _offset; }
+inline tim::uint MeshBuffers::baseVertex() const { return _baseVertex; }
 inline int64_t MeshBuffers::numIndices() const { return _numIndexes; }
-inline MeshBuffers::Topology MeshBuffers::topology() const { return _topology; }
\ No newline at end of file
+inline MeshBuffers::Topology MeshBuffers::topology() const { return _topology; }
+inline const tim::vec4& MeshBuffers::positionDecode() const { return _positionDecode; }
+inline const tim::vec4& MeshBuffers::uvDecode() const { return _uvDecode; }
\ No newline at end of file
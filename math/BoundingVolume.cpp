@@ -0,0 +1,392 @@
+#include "BoundingVolume.h"
+#include "Parallel.h"
+
+#include <EASTL/vector.h>
+
+#if defined(_M_X64) || defined(__SSE__)
+#include <xmmintrin.h>
+#define BOUNDING_VOLUME_SSE
+#endif
+
+namespace tim
+{
+
+namespace
+{
+    const uint CHUNK_SIZE = 1 << 13;
+
+    inline vec3 point(const float* ptr, uint i, uint stride)
+    {
+        const float* p = ptr + size_t(i) * stride;
+        return vec3(p[0], p[1], p[2]);
+    }
+
+    /* Run fun(begin, end, chunkIndex) over the chunks of the points, in parallel for the large sets */
+    template<class F>
+    uint forEachChunk(uint size, const F& fun)
+    {
+        const uint nbChunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        auto runChunk = [&](uint chunk)
+        {
+            fun(chunk * CHUNK_SIZE, eastl::min(size, (chunk + 1) * CHUNK_SIZE), chunk);
+        };
+
+        if (size >= BoundingVolume::PARALLEL_THRESHOLD)
+            parallelFor(nbChunks, runChunk);
+        else
+        {
+            for (uint chunk = 0; chunk < nbChunks; ++chunk)
+                runChunk(chunk);
+        }
+        return nbChunks;
+    }
+
+    void boxOfRange(const float* ptr, uint begin, uint end, uint stride, vec3& minB, vec3& maxB)
+    {
+#ifdef BOUNDING_VOLUME_SSE
+        // 4 floats are loaded per point, the last point of the set is done apart to not read past the end
+        if (end - begin > 1)
+        {
+            __m128 minV = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128 maxV = _mm_set1_ps(-std::numeric_limits<float>::max());
+            const float* p = ptr + size_t(begin) * stride;
+            for (uint i = begin; i < end - 1; ++i, p += stride)
+            {
+                __m128 v = _mm_loadu_ps(p);
+                minV = _mm_min_ps(minV, v);
+                maxV = _mm_max_ps(maxV, v);
+            }
+
+            float minF[4], maxF[4];
+            _mm_storeu_ps(minF, minV);
+            _mm_storeu_ps(maxF, maxV);
+            for (int a = 0; a < 3; ++a)
+            {
+                minB[a] = eastl::min(minB[a], minF[a]);
+                maxB[a] = eastl::max(maxB[a], maxF[a]);
+            }
+            begin = end - 1;
+        }
+#endif
+        for (uint i = begin; i < end; ++i)
+        {
+            const float* p = ptr + size_t(i) * stride;
+            for (int a = 0; a < 3; ++a)
+            {
+                minB[a] = eastl::min(minB[a], p[a]);
+                maxB[a] = eastl::max(maxB[a], p[a]);
+            }
+        }
+    }
+
+    /* Index of the points with the smallest and the largest coordinate on each axis */
+    struct ExtremePoints
+    {
+        uint minIndex[3] = { 0,0,0 }, maxIndex[3] = { 0,0,0 };
+        vec3 minV = vec3::construct(std::numeric_limits<float>::max());
+        vec3 maxV = vec3::construct(-std::numeric_limits<float>::max());
+
+        void add(const ExtremePoints& e)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                if (e.minV[a] < minV[a]) { minV[a] = e.minV[a]; minIndex[a] = e.minIndex[a]; }
+                if (e.maxV[a] > maxV[a]) { maxV[a] = e.maxV[a]; maxIndex[a] = e.maxIndex[a]; }
+            }
+        }
+    };
+
+    ExtremePoints computeExtremePoints(const float* ptr, uint size, uint stride)
+    {
+        eastl::vector<ExtremePoints> chunks((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        forEachChunk(size, [&](uint begin, uint end, uint chunk)
+        {
+            ExtremePoints& e = chunks[chunk];
+            for (uint i = begin; i < end; ++i)
+            {
+                const float* p = ptr + size_t(i) * stride;
+                for (int a = 0; a < 3; ++a)
+                {
+                    if (p[a] < e.minV[a]) { e.minV[a] = p[a]; e.minIndex[a] = i; }
+                    if (p[a] > e.maxV[a]) { e.maxV[a] = p[a]; e.maxIndex[a] = i; }
+                }
+            }
+        });
+
+        ExtremePoints result;
+        for (const ExtremePoints& e : chunks)
+            result.add(e);
+        return result;
+    }
+
+    /* Grow the sphere just enough to contain p, the opposite side of the sphere does not move */
+    inline void growSphere(vec3& center, float& radius, vec3 p)
+    {
+        vec3 d = p - center;
+        float dist2 = d.length2();
+        if (dist2 <= radius * radius)
+            return;
+
+        float dist = sqrtf(dist2);
+        float newRadius = (radius + dist) * 0.5f;
+        center += d * ((newRadius - radius) / dist);
+        radius = newRadius;
+    }
+
+    /* Eigen vectors (rows of vectors) and values of a symmetric matrix, with the Jacobi rotations */
+    void symmetricEigen(float a[3][3], mat3& vectors, vec3& values)
+    {
+        float v[3][3] = { { 1,0,0 },{ 0,1,0 },{ 0,0,1 } };
+
+        for (int sweep = 0; sweep < 32; ++sweep)
+        {
+            float offDiagonal = fabsf(a[0][1]) + fabsf(a[0][2]) + fabsf(a[1][2]);
+            if (offDiagonal < 1e-12f)
+                break;
+
+            for (int p = 0; p < 2; ++p)
+            {
+                for (int q = p + 1; q < 3; ++q)
+                {
+                    if (fabsf(a[p][q]) < 1e-20f)
+                        continue;
+
+                    float theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                    float t = (theta >= 0 ? 1.f : -1.f) / (fabsf(theta) + sqrtf(theta * theta + 1));
+                    float c = 1.f / sqrtf(t * t + 1), s = t * c;
+
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        float akp = a[k][p], akq = a[k][q];
+                        a[k][p] = c * akp - s * akq;
+                        a[k][q] = s * akp + c * akq;
+                    }
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        float apk = a[p][k], aqk = a[q][k];
+                        a[p][k] = c * apk - s * aqk;
+                        a[q][k] = s * apk + c * aqk;
+                    }
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        float vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - s * vkq;
+                        v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            values[i] = a[i][i];
+            vectors[i] = vec3(v[0][i], v[1][i], v[2][i]);
+        }
+    }
+}
+
+BoundingVolume::Box BoundingVolume::computeBox(const float* ptr, uint size, uint stride)
+{
+    eastl::vector<Box> chunks((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    forEachChunk(size, [&](uint begin, uint end, uint chunk)
+    {
+        boxOfRange(ptr, begin, end, stride, chunks[chunk].min, chunks[chunk].max);
+    });
+
+    Box box;
+    for (const Box& b : chunks)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            box.min[a] = eastl::min(box.min[a], b.min[a]);
+            box.max[a] = eastl::max(box.max[a], b.max[a]);
+        }
+    }
+    return box;
+}
+
+float BoundingVolume::computeRadius(vec3 center, const float* ptr, uint size, uint stride)
+{
+    eastl::vector<float> chunks((size + CHUNK_SIZE - 1) / CHUNK_SIZE, 0.f);
+    forEachChunk(size, [&](uint begin, uint end, uint chunk)
+    {
+        float maxD2 = 0;
+        for (uint i = begin; i < end; ++i)
+            maxD2 = eastl::max(maxD2, (point(ptr, i, stride) - center).length2());
+        chunks[chunk] = maxD2;
+    });
+
+    float maxD2 = 0;
+    for (float d2 : chunks)
+        maxD2 = eastl::max(maxD2, d2);
+    return sqrtf(maxD2);
+}
+
+Sphere BoundingVolume::ritterSphere(const float* ptr, uint size, uint stride)
+{
+    if (size == 0)
+        return Sphere();
+
+    ExtremePoints e = computeExtremePoints(ptr, size, stride);
+
+    int axis = 0;
+    float maxD2 = -1;
+    for (int a = 0; a < 3; ++a)
+    {
+        float d2 = (point(ptr, e.maxIndex[a], stride) - point(ptr, e.minIndex[a], stride)).length2();
+        if (d2 > maxD2)
+        {
+            maxD2 = d2;
+            axis = a;
+        }
+    }
+
+    vec3 p0 = point(ptr, e.minIndex[axis], stride), p1 = point(ptr, e.maxIndex[axis], stride);
+    vec3 center = (p0 + p1) * 0.5f;
+    float radius = (p1 - p0).length() * 0.5f;
+
+    // the growing pass depends on the order of the points, it stays sequential
+    for (uint i = 0; i < size; ++i)
+        growSphere(center, radius, point(ptr, i, stride));
+
+    // the rounding of the growing steps can leave a point slightly outside
+    return Sphere(center, eastl::max(radius, computeRadius(center, ptr, size, stride)));
+}
+
+Sphere BoundingVolume::minimalSphere(const float* ptr, uint size, uint stride, uint iterations)
+{
+    Sphere best = ritterSphere(ptr, size, stride);
+    if (size <= 2)
+        return best;
+
+    // the sphere around the center of the box is better for the symmetric sets
+    vec3 boxCenter = computeBox(ptr, size, stride).center();
+    float boxRadius = computeRadius(boxCenter, ptr, size, stride);
+    if (boxRadius < best.radius())
+        best = Sphere(boxCenter, boxRadius);
+
+    // a step coprime with size visits every point once, each iteration in a different order
+    static const uint STEPS[] = { 1, 7919, 104729, 1299709, 15485863, 32452843 };
+    auto gcd = [](uint a, uint b) { while (b) { uint t = a % b; a = b; b = t; } return a; };
+
+    vec3 center = best.center();
+    float radius = best.radius();
+
+    for (uint it = 0; it < iterations; ++it)
+    {
+        uint step = STEPS[it % (sizeof(STEPS) / sizeof(STEPS[0]))];
+        while (gcd(step, size) != 1)
+            ++step;
+
+        // shrink more at the start, finer at the end
+        radius = best.radius() * (it < iterations / 2 ? 0.95f : 0.99f);
+        center = best.center();
+
+        uint index = (it * 2654435761u) % size;
+        for (uint i = 0; i < size; ++i)
+        {
+            growSphere(center, radius, point(ptr, index, stride));
+            index = uint((uint64_t(index) + step) % size);
+        }
+
+        float exactRadius = computeRadius(center, ptr, size, stride);
+        if (exactRadius < best.radius())
+            best = Sphere(center, exactRadius);
+    }
+
+    return best;
+}
+
+BoundingVolume::OrientedBox BoundingVolume::computeOrientedBox(const float* ptr, uint size, uint stride)
+{
+    OrientedBox obb;
+    if (size == 0)
+        return obb;
+
+    // mean then covariance, in double since the sums run over large sets
+    struct Moments
+    {
+        double sum[3] = { 0,0,0 };
+        double cov[6] = { 0,0,0,0,0,0 };
+    };
+    eastl::vector<Moments> chunks((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+    forEachChunk(size, [&](uint begin, uint end, uint chunk)
+    {
+        for (uint i = begin; i < end; ++i)
+        {
+            const float* p = ptr + size_t(i) * stride;
+            for (int a = 0; a < 3; ++a)
+                chunks[chunk].sum[a] += p[a];
+        }
+    });
+
+    double mean[3] = { 0,0,0 };
+    for (const Moments& m : chunks)
+        for (int a = 0; a < 3; ++a)
+            mean[a] += m.sum[a];
+    for (int a = 0; a < 3; ++a)
+        mean[a] /= size;
+
+    forEachChunk(size, [&](uint begin, uint end, uint chunk)
+    {
+        double* cov = chunks[chunk].cov;
+        for (uint i = begin; i < end; ++i)
+        {
+            const float* p = ptr + size_t(i) * stride;
+            double x = p[0] - mean[0], y = p[1] - mean[1], z = p[2] - mean[2];
+            cov[0] += x*x; cov[1] += x*y; cov[2] += x*z;
+            cov[3] += y*y; cov[4] += y*z; cov[5] += z*z;
+        }
+    });
+
+    double cov[6] = { 0,0,0,0,0,0 };
+    for (const Moments& m : chunks)
+        for (int k = 0; k < 6; ++k)
+            cov[k] += m.cov[k];
+
+    float a[3][3] = { { float(cov[0] / size), float(cov[1] / size), float(cov[2] / size) },
+                      { float(cov[1] / size), float(cov[3] / size), float(cov[4] / size) },
+                      { float(cov[2] / size), float(cov[4] / size), float(cov[5] / size) } };
+
+    vec3 values;
+    symmetricEigen(a, obb.axes, values);
+
+    for (int i = 0; i < 3; ++i)
+        obb.axes[i].normalize();
+
+    // right handed frame
+    obb.axes[2] = obb.axes[0].cross(obb.axes[1]).normalized();
+
+    // extents along the axes
+    eastl::vector<Box> extents(chunks.size());
+    forEachChunk(size, [&](uint begin, uint end, uint chunk)
+    {
+        Box& b = extents[chunk];
+        for (uint i = begin; i < end; ++i)
+        {
+            vec3 local = obb.axes * point(ptr, i, stride);
+            for (int k = 0; k < 3; ++k)
+            {
+                b.min[k] = eastl::min(b.min[k], local[k]);
+                b.max[k] = eastl::max(b.max[k], local[k]);
+            }
+        }
+    });
+
+    Box local;
+    for (const Box& b : extents)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            local.min[k] = eastl::min(local.min[k], b.min[k]);
+            local.max[k] = eastl::max(local.max[k], b.max[k]);
+        }
+    }
+
+    obb.halfSize = local.halfSize();
+    obb.center = obb.axes.transposed() * local.center();
+    return obb;
+}
+
+}
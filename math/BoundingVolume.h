@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Vector.h"
+#include "Matrix.h"
+#include "Sphere.h"
+
+namespace tim
+{
+    /* Bounding volumes of a point set. The points are read as 3 floats every stride floats, as in Sphere::computeSphere.
+       The passes over the points are split in chunks reduced on g_threadPool for the large sets,
+       the result does not depend on the number of threads. */
+    class BoundingVolume
+    {
+    public:
+        static const uint PARALLEL_THRESHOLD = 1 << 15;
+
+        struct Box
+        {
+            vec3 min = vec3::construct(std::numeric_limits<float>::max());
+            vec3 max = vec3::construct(-std::numeric_limits<float>::max());
+
+            bool empty() const { return min.x() > max.x(); }
+            vec3 center() const { return (min + max) * 0.5f; }
+            vec3 halfSize() const { return (max - min) * 0.5f; }
+            Sphere sphere() const { return Sphere(center(), halfSize().length()); }
+        };
+
+        /* The rows of axes are the axes of the box */
+        struct OrientedBox
+        {
+            vec3 center;
+            mat3 axes = mat3::IDENTITY();
+            vec3 halfSize;
+
+            float volume() const { return halfSize.x() * halfSize.y() * halfSize.z() * 8; }
+            Sphere sphere() const { return Sphere(center, halfSize.length()); }
+        };
+
+        BoundingVolume() = delete;
+
+        static Box computeBox(const float* ptr, uint size, uint stride = 3);
+
+        /* Ritter's sphere, from the most distant pair of extreme points on the axes, about 5 to 20% larger than the minimal one */
+        static Sphere ritterSphere(const float* ptr, uint size, uint stride = 3);
+
+        /* Ritter's sphere refined by shrinking it and growing it back over the points, visited in a different order each time.
+           Usually within a few percents of the minimal sphere */
+        static Sphere minimalSphere(const float* ptr, uint size, uint stride = 3, uint iterations = 8);
+
+        /* Box along the principal axes of the points */
+        static OrientedBox computeOrientedBox(const float* ptr, uint size, uint stride = 3);
+
+        /* Smallest radius around center containing all the points */
+        static float computeRadius(vec3 center, const float* ptr, uint size, uint stride = 3);
+    };
+}
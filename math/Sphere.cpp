@@ -75,7 +75,7 @@ std::string Sphere::str() const
 
 Sphere Sphere::computeSphere(const float* ptr, uint size, uint stride)
 {
-    vec3 minV = vec3::construct(std::numeric_limits<float>::max()), maxV = vec3::construct(std::numeric_limits<float>::min());
+    vec3 minV = vec3::construct(std::numeric_limits<float>::max()), maxV = vec3::construct(-std::numeric_limits<float>::max());
 
     for(uint i=0 ; i<size ; ++i)
     {
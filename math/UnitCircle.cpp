@@ -0,0 +1,55 @@
+#include "UnitCircle.h"
+#include <EASTL/vector.h>
+
+namespace tim
+{
+
+namespace
+{
+    void fillTable(vec2* table, uint resolution)
+    {
+        for(uint j=0 ; j<resolution ; ++j)
+        {
+            const float theta = TAU * float(j) / resolution;
+            table[j] = vec2(cosf(theta), sinf(theta));
+        }
+    }
+
+    struct Tables
+    {
+        eastl::vector<vec2> data;
+        uint offset[UnitCircle::MAX_RESOLUTION + 1];
+
+        Tables()
+        {
+            uint size = 0;
+            for(uint r=0 ; r<=UnitCircle::MAX_RESOLUTION ; ++r)
+            {
+                offset[r] = size;
+                size += r;
+            }
+
+            data.resize(size);
+            for(uint r=1 ; r<=UnitCircle::MAX_RESOLUTION ; ++r)
+                fillTable(data.data() + offset[r], r);
+        }
+    };
+}
+
+const vec2* UnitCircle::table(uint resolution)
+{
+    static const Tables tables; // the initialization of a local static is thread safe
+
+    if(resolution <= MAX_RESOLUTION)
+        return tables.data.data() + tables.offset[resolution];
+
+    thread_local eastl::vector<vec2> large;
+    if(large.size() != resolution)
+    {
+        large.resize(resolution);
+        fillTable(large.data(), resolution);
+    }
+    return large.data();
+}
+
+}
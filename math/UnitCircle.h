@@ -0,0 +1,22 @@
+#ifndef UNITCIRCLE_H
+#define UNITCIRCLE_H
+
+#include "Vector.h"
+
+namespace tim
+{
+    /* cos and sin of the angles TAU*j/resolution, j in [0,resolution), for the rings of the tubes.
+       The tables up to MAX_RESOLUTION are computed once and shared by all the threads,
+       a larger resolution is computed in a buffer of the calling thread, valid until its next call. */
+    class UnitCircle
+    {
+    public:
+        static const uint MAX_RESOLUTION = 128;
+
+        UnitCircle() = delete;
+
+        static const vec2* table(uint resolution);
+    };
+}
+
+#endif // UNITCIRCLE_H